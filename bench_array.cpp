@@ -0,0 +1,196 @@
+#include "core/array.h"
+#include <chrono>
+#include <deque>
+#include <vector>
+
+/*
+ * TArray against std::vector, std::deque and the std::vector<T*> plus
+ * one allocation per element pattern it replaces. every container is
+ * filled, indexed, walked and drained again.
+ */
+
+#define COUNT (1 << 20)
+#define ROUNDS 10
+
+struct FItem
+{
+	size_t Key;
+	size_t Value[3];
+};
+
+static double Now()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void Report(const char* Name, double Push, double Index, double Walk, double Pop)
+{
+	printf("%-16s %8.2f %8.2f %8.2f %8.2f\n", Name, Push / (COUNT * ROUNDS), Index / (COUNT * ROUNDS),
+		Walk / (COUNT * ROUNDS), Pop / (COUNT * ROUNDS));
+}
+
+/* a generic run over any container with push_back/operator[]/pop_back */
+template < typename TContainer> static void Run(const char* Name)
+{
+	double Push = 0, Index = 0, Walk = 0, Pop = 0;
+	volatile size_t Sink = 0;
+
+	for(int Round = 0; Round < ROUNDS; Round++)
+	{
+		TContainer Container;
+		double Start = Now();
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Container.push_back(FItem{i, {i, i, i}});
+		}
+
+		double Pushed = Now();
+		size_t Sum = 0;
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Sum += Container[(i * 7919) % COUNT].Key;
+		}
+
+		double Indexed = Now();
+
+		for(const FItem& Item : Container)
+		{
+			Sum += Item.Value[0];
+		}
+
+		double Walked = Now();
+
+		while(!Container.empty())
+		{
+			Container.pop_back();
+		}
+
+		double Popped = Now();
+
+		Sink = Sink + Sum;
+		Push += Pushed - Start;
+		Index += Indexed - Pushed;
+		Walk += Walked - Indexed;
+		Pop += Popped - Walked;
+	}
+
+	Report(Name, Push, Index, Walk, Pop);
+}
+
+static void RunPointers()
+{
+	double Push = 0, Index = 0, Walk = 0, Pop = 0;
+	volatile size_t Sink = 0;
+
+	for(int Round = 0; Round < ROUNDS; Round++)
+	{
+		std::vector<FItem*> Container;
+		double Start = Now();
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Container.push_back(new FItem{i, {i, i, i}});
+		}
+
+		double Pushed = Now();
+		size_t Sum = 0;
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Sum += Container[(i * 7919) % COUNT]->Key;
+		}
+
+		double Indexed = Now();
+
+		for(const FItem* Item : Container)
+		{
+			Sum += Item->Value[0];
+		}
+
+		double Walked = Now();
+
+		while(!Container.empty())
+		{
+			delete Container.back();
+			Container.pop_back();
+		}
+
+		double Popped = Now();
+
+		Sink = Sink + Sum;
+		Push += Pushed - Start;
+		Index += Indexed - Pushed;
+		Walk += Walked - Indexed;
+		Pop += Popped - Walked;
+	}
+
+	Report("vector<T*>+new", Push, Index, Walk, Pop);
+}
+
+static void RunArray()
+{
+	double Push = 0, Index = 0, Walk = 0, Pop = 0;
+	volatile size_t Sink = 0;
+
+	for(int Round = 0; Round < ROUNDS; Round++)
+	{
+		TArray<FItem, 256> Container;
+		double Start = Now();
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Container.Add(FItem{i, {i, i, i}});
+		}
+
+		double Pushed = Now();
+		size_t Sum = 0;
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Sum += Container[(i * 7919) % COUNT].Key;
+		}
+
+		double Indexed = Now();
+
+		/* walk chunk by chunk, each one is contiguous */
+		Container.ForEachChunk([&](const FItem* Items, size_t Num)
+		{
+			for(size_t i = 0; i < Num; i++)
+			{
+				Sum += Items[i].Value[0];
+			}
+		});
+
+		double Walked = Now();
+
+		while(!Container.IsEmpty())
+		{
+			Container.Pop();
+		}
+
+		double Popped = Now();
+
+		Sink = Sink + Sum;
+		Push += Pushed - Start;
+		Index += Indexed - Pushed;
+		Walk += Walked - Indexed;
+		Pop += Popped - Walked;
+	}
+
+	Report("TArray", Push, Index, Walk, Pop);
+}
+
+int main()
+{
+	printf("container        push(ns) index(ns) walk(ns)  pop(ns)\n");
+
+	Run<std::vector<FItem>>("std::vector");
+	Run<std::deque<FItem>>("std::deque");
+	RunPointers();
+	RunArray();
+
+	return 0;
+}
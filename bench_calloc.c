@@ -0,0 +1,108 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sfpool.h"
+#include <time.h>
+
+/*
+ * zeroed allocation: a working set of blocks is filled once, then a part
+ * of it is freed and allocated again, zeroed, in every round. it compares
+ * sfpool_alloc() followed by memset() on heap pages with sfpool_calloc()
+ * on mapped pages, which skips blocks that are known to be zero, and with
+ * a pool which zeroes blocks when they are freed.
+ */
+
+#define BLOCK_SIZE  256
+#define PAGE_SIZE   256
+#define BLOCKS      (PAGE_SIZE * 256)
+#define CHURN       (BLOCKS / 8)
+#define ROUNDS      50
+
+enum MODE
+{
+    MODE_MEMSET = 0,
+    MODE_CALLOC = 1,
+    MODE_ZERO_ON_FREE = 2,
+};
+
+static void* blocks[BLOCKS];
+
+static void* alloc_zero (struct sfpool* pool,enum MODE mode)
+{
+    if(mode == MODE_MEMSET)
+    {
+        void* block = sfpool_alloc(pool);
+
+        memset(block,0,pool->block_size);
+        return block;
+    }
+
+    return sfpool_calloc(pool);
+}
+
+static double run (enum MODE mode,size_t* cleared,size_t* saved)
+{
+    struct sfpool pool;
+    struct timespec start,end;
+    size_t seed = 1;
+
+    sfpool_create(&pool,BLOCK_SIZE,PAGE_SIZE,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_set_page_mapped(&pool,mode != MODE_MEMSET);
+    sfpool_set_zero_on_free(&pool,mode == MODE_ZERO_ON_FREE);
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+
+    for(size_t i = 0;i < BLOCKS;i++)
+    {
+        blocks[i] = alloc_zero(&pool,mode);
+        *(size_t*) blocks[i] = i;
+    }
+
+    for(size_t round = 0;round < ROUNDS;round++)
+    {
+        for(size_t i = 0;i < CHURN;i++)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t pos = (seed >> 33) % BLOCKS;
+
+            sfpool_free(&pool,blocks[pos]);
+            blocks[pos] = alloc_zero(&pool,mode);
+            *(size_t*) blocks[pos] = pos;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&end);
+
+    size_t total = (BLOCKS + (size_t) ROUNDS * CHURN) * pool.block_size;
+
+    /* the blocks cleared by memset() are not seen by the pool */
+    *saved = pool.zero_saved;
+    *cleared = mode == MODE_MEMSET ? total : pool.zero_cleared;
+
+    sfpool_destroy(&pool);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+    return ns / ((double) BLOCKS + (double) ROUNDS * CHURN);
+}
+
+int main (void)
+{
+    const char* names[] = { "alloc + memset", "sfpool_calloc", "calloc + zero on free" };
+    size_t cleared,saved;
+
+    /* warm up */
+    run(MODE_CALLOC,&cleared,&saved);
+
+    printf("zeroed allocation of %d byte blocks, bytes cleared and never cleared\n",BLOCK_SIZE);
+    printf("%-22s : %8s %14s %14s\n","","ns/alloc","cleared (KiB)","saved (KiB)");
+
+    for(int mode = MODE_MEMSET;mode <= MODE_ZERO_ON_FREE;mode++)
+    {
+        double ns = run((enum MODE) mode,&cleared,&saved);
+
+        printf("%-22s : %8.2f %14lu %14lu\n",names[mode],ns,
+               (unsigned long) (cleared / 1024),(unsigned long) (saved / 1024));
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sfpool.h"
+#include <time.h>
+
+/*
+ * multi page scan: touch the same slot of every page, then the next slot.
+ * without cache coloring slot N of every page has the same offset in its
+ * granule and all of them fight for the same few cache sets.
+ */
+
+#define PAGES   4096
+#define SLOTS   63
+#define ROUNDS  20
+
+static void* blocks[SLOTS][PAGES];
+
+static double scan (bool_t colored)
+{
+    struct sfpool pool;
+    struct timespec start,end;
+    volatile size_t sink = 0;
+
+    /* 63 blocks of 64 bytes, the page leaves almost a whole granule of slack */
+    sfpool_create(&pool,64 - sizeof(size_t),SLOTS,SFPOOL_EXPAND_TYPE_ONE);
+
+    sfpool_set_coloring(&pool,colored);
+
+    for(size_t page = 0;page < PAGES;page++)
+    {
+        for(size_t slot = 0;slot < SLOTS;slot++)
+        {
+            blocks[slot][page] = sfpool_alloc(&pool);
+            *(size_t*) blocks[slot][page] = slot;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+
+    for(size_t round = 0;round < ROUNDS;round++)
+    {
+        size_t sum = 0;
+
+        for(size_t slot = 0;slot < SLOTS;slot++)
+        {
+            for(size_t page = 0;page < PAGES;page++)
+            {
+                sum += *(size_t*) blocks[slot][page];
+            }
+        }
+
+        sink = sink + sum;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&end);
+
+    sfpool_destroy(&pool);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+    return ns / ((double) ROUNDS * SLOTS * PAGES);
+}
+
+int main (void)
+{
+    /* warm up */
+    scan(1);
+
+    printf("same slot across %d pages (ns/access)\n",PAGES);
+    printf("without coloring : %.2f\n",scan(0));
+    printf("with coloring    : %.2f\n",scan(1));
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "core/coroutine.h"
+#include <chrono>
+#include <coroutine>
+
+/*
+ * millions of short-lived coroutines: each one is created, resumed to its
+ * end and destroyed. frames from FCoroFrameAllocator against the global heap.
+ */
+
+#define COUNT (4 << 20)
+
+struct FHeapPromise
+{
+};
+
+template < typename TPromiseBase> struct TTask
+{
+	struct promise_type : TPromiseBase
+	{
+		size_t Value = 0;
+
+		TTask get_return_object() { return TTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_value(size_t InValue) { Value = InValue; }
+		void unhandled_exception() {}
+	};
+
+	explicit TTask(std::coroutine_handle<promise_type> InHandle) : Handle(InHandle) {}
+	~TTask() { Handle.destroy(); }
+
+	size_t Run() { Handle.resume(); return Handle.promise().Value; }
+
+	std::coroutine_handle<promise_type> Handle;
+};
+
+template < typename TPromiseBase> __attribute__((noinline)) TTask<TPromiseBase> Step(size_t Value)
+{
+	/* some locals to give the frame a realistic size */
+	size_t Local[8];
+
+	for(size_t i = 0; i < 8; i++)
+	{
+		Local[i] = Value + i;
+	}
+
+	co_await std::suspend_never();
+	co_return Local[Value % 8];
+}
+
+template < typename TPromiseBase> static double Run()
+{
+	volatile size_t Sink = 0;
+	auto Start = std::chrono::steady_clock::now();
+
+	for(size_t i = 0; i < COUNT; i++)
+	{
+		TTask<TPromiseBase> Task = Step<TPromiseBase>(i);
+		Sink = Sink + Task.Run();
+	}
+
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / COUNT;
+}
+
+int main()
+{
+	/* warm up both */
+	Run<FHeapPromise>();
+	Run<FPooledPromise>();
+
+	printf("%d coroutines (ns per create/resume/destroy)\n", COUNT);
+	printf("global heap          : %.2f\n", Run<FHeapPromise>());
+	printf("FCoroFrameAllocator  : %.2f\n", Run<FPooledPromise>());
+
+	return 0;
+}
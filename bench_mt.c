@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sfpool.h"
+#include "sfpool_mt.h"
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * MPMC contention benchmark: every thread allocates a block, swaps it into
+ * a shared slot table and frees whatever block it got out of there, so
+ * most blocks are freed by a thread other than the one that allocated them.
+ * sfpool_mt is compared to sfpool behind a global mutex.
+ */
+
+#define OPS         (1 << 20)
+#define SLOTS       1024
+#define MAX_THREADS 64
+
+static struct sfpool_mt mt_pool;
+static struct sfpool pool;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* slots[SLOTS];
+static size_t ops_per_thread;
+
+static void* locked_alloc (void)
+{
+    pthread_mutex_lock(&pool_lock);
+    void* block = sfpool_alloc(&pool);
+    pthread_mutex_unlock(&pool_lock);
+    return block;
+}
+
+static void locked_free (void* block)
+{
+    pthread_mutex_lock(&pool_lock);
+    sfpool_free(&pool,block);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void* mt_alloc (void)
+{
+    return sfpool_mt_alloc(&mt_pool);
+}
+
+static void mt_free (void* block)
+{
+    sfpool_mt_free(&mt_pool,block);
+}
+
+static void* (*bench_alloc) (void);
+static void (*bench_free) (void*);
+
+static void* worker (void* arg)
+{
+    unsigned int seed = (unsigned int) (size_t) arg;
+
+    for(size_t i = 0;i < ops_per_thread;i++)
+    {
+        void* block = bench_alloc();
+        size_t slot = (size_t) rand_r(&seed) % SLOTS;
+        void* other = __atomic_exchange_n(&slots[slot],block,__ATOMIC_ACQ_REL);
+
+        if(other != NULL)
+        {
+            bench_free(other);
+        }
+    }
+
+    return NULL;
+}
+
+static double run (size_t thread_count)
+{
+    pthread_t threads[MAX_THREADS];
+    struct timespec start,end;
+
+    ops_per_thread = OPS / thread_count;
+
+    clock_gettime(CLOCK_MONOTONIC,&start);
+
+    for(size_t i = 0;i < thread_count;i++)
+    {
+        pthread_create(&threads[i],NULL,worker,(void*) (i + 1));
+    }
+
+    for(size_t i = 0;i < thread_count;i++)
+    {
+        pthread_join(threads[i],NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&end);
+
+    for(size_t i = 0;i < SLOTS;i++)
+    {
+        if(slots[i] != NULL)
+        {
+            bench_free(slots[i]);
+            slots[i] = NULL;
+        }
+    }
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+    /* one alloc and (almost) one free per iteration */
+    return ns / (double) (ops_per_thread * thread_count * 2);
+}
+
+int main (void)
+{
+    sfpool_create(&pool,32,256,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_mt_create(&mt_pool,32,256,4096);
+
+    printf("threads   sfpool+mutex (ns/op)   sfpool_mt (ns/op)\n");
+
+    for(size_t threads = 1;threads <= MAX_THREADS;threads *= 2)
+    {
+        bench_alloc = locked_alloc;
+        bench_free = locked_free;
+        double locked = run(threads);
+
+        bench_alloc = mt_alloc;
+        bench_free = mt_free;
+        double mt = run(threads);
+
+        printf("%7lu   %20.1f   %17.1f\n",(unsigned long) threads,locked,mt);
+    }
+
+    sfpool_mt_destroy(&mt_pool);
+    sfpool_destroy(&pool);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "sfpool.h"
+#include <chrono>
+
+/*
+ * ns/op of the out-of-line C calls in libsfpool.so against the inlined
+ * fast path of the SFPool template, on the same block and page sizes.
+ */
+
+#define COUNT (1 << 16)
+#define ROUNDS 200
+
+static void* Blocks[COUNT];
+
+static double Now()
+{
+	return std::chrono::duration<double, std::nano>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template < typename TAlloc, typename TFree> static void Run(const char* Name, TAlloc Alloc, TFree Free)
+{
+	/* allocate a batch, then free it */
+	double Start = Now();
+
+	for(int Round = 0; Round < ROUNDS; Round++)
+	{
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Blocks[i] = Alloc();
+		}
+
+		for(size_t i = 0; i < COUNT; i++)
+		{
+			Free(Blocks[i]);
+		}
+	}
+
+	double Batch = (Now() - Start) / (2.0 * COUNT * ROUNDS);
+
+	/* keep a few blocks alive and churn a single one */
+	for(size_t i = 0; i < 16; i++)
+	{
+		Blocks[i] = Alloc();
+	}
+
+	Start = Now();
+
+	for(size_t i = 0; i < (size_t) COUNT * ROUNDS; i++)
+	{
+		void* Block = Alloc();
+		*(volatile size_t*) Block = i;
+		Free(Block);
+	}
+
+	double Churn = (Now() - Start) / (2.0 * COUNT * ROUNDS);
+
+	for(size_t i = 0; i < 16; i++)
+	{
+		Free(Blocks[i]);
+	}
+
+	printf("%-12s %10.2f %10.2f\n", Name, Batch, Churn);
+}
+
+int main()
+{
+	SFPool<32, 256> Pool;
+	struct sfpool CPool;
+
+	sfpool_create(&CPool, 32, 256, SFPOOL_EXPAND_TYPE_ONE);
+
+	printf("             batch(ns)  churn(ns)\n");
+
+	Run("sfpool_*", [&]() { return sfpool_alloc(&CPool); }, [&](void* Block) { sfpool_free(&CPool, Block); });
+	Run("SFPool<>", [&]() { return Pool.Alloc(); }, [&](void* Block) { Pool.Free(Block); });
+
+	sfpool_destroy(&CPool);
+	return 0;
+}
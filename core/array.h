@@ -1,6 +1,211 @@
 #pragma once
 
-template < typename T> class TArray
+#include <new>
+#include <utility>
+#include "../sfpool.h"
+
+/*
+ * chunked dynamic array. elements live in fixed size chunks which are
+ * blocks of an sfpool, so adding, removing and indexing never move an
+ * element and growing never copies one. only the table of chunk
+ * pointers is reallocated, and it holds one pointer per 'ChunkSize'
+ * elements. elements of a chunk are contiguous, see GetChunk().
+ *
+ * every array has a pool of its own, taken with the first chunk. a page
+ * holds one chunk by default, so a small array does not keep a page of
+ * chunks it never uses.
+ */
+template < typename T, size_t ChunkSize = 64, size_t ChunksPerPage = 1> class TArray
 {
-	
-}
\ No newline at end of file
+	static_assert(ChunkSize > 0 && ChunksPerPage > 0, "empty chunks or pages");
+	static_assert(alignof(T) <= SFPOOL_CACHE_LINE, "sfpool blocks are at most cache line aligned");
+
+public:
+	TArray() {}
+
+	~TArray()
+	{
+		Empty();
+		free(Chunks);
+		delete Pool;
+	}
+
+	TArray(const TArray&) = delete;
+	TArray& operator = (const TArray&) = delete;
+
+	/* the pool moves along with the chunks, no element is moved */
+	TArray(TArray&& Other)
+		: Pool(Other.Pool), Chunks(Other.Chunks), ChunkCount(Other.ChunkCount),
+		  ChunkCapacity(Other.ChunkCapacity), Count(Other.Count)
+	{
+		Other.Reset();
+	}
+
+	TArray& operator = (TArray&& Other)
+	{
+		if(this != &Other)
+		{
+			Empty();
+			free(Chunks);
+			delete Pool;
+
+			Pool = Other.Pool;
+			Chunks = Other.Chunks;
+			ChunkCount = Other.ChunkCount;
+			ChunkCapacity = Other.ChunkCapacity;
+			Count = Other.Count;
+
+			Other.Reset();
+		}
+
+		return *this;
+	}
+
+	size_t Num() const { return Count; }
+	bool IsEmpty() const { return Count == 0; }
+
+	T& operator [] (size_t Index) { return Chunks[Index / ChunkSize][Index % ChunkSize]; }
+	const T& operator [] (size_t Index) const { return Chunks[Index / ChunkSize][Index % ChunkSize]; }
+
+	T& Last() { return (*this)[Count - 1]; }
+	const T& Last() const { return (*this)[Count - 1]; }
+
+	T& Add(const T& Item) { return Emplace(Item); }
+	T& Add(T&& Item) { return Emplace(std::move(Item)); }
+
+	/* construct a new element at the end, throws std::bad_alloc if no chunk can be taken */
+	template < typename... TArgs> T& Emplace(TArgs&&... Args)
+	{
+		if(Count == ChunkCount * ChunkSize)
+		{
+			AddChunk();
+		}
+
+		T* Item = &Chunks[Count / ChunkSize][Count % ChunkSize];
+		new (Item) T(std::forward<TArgs>(Args)...);
+		Count++;
+		return *Item;
+	}
+
+	/* destroy the last element */
+	void Pop()
+	{
+		Count--;
+		(*this)[Count].~T();
+
+		/* keep one empty chunk around, so Add/Pop at a chunk border does not hit the pool */
+		if(ChunkCount * ChunkSize - Count >= 2 * ChunkSize)
+		{
+			RemoveChunk();
+		}
+	}
+
+	/* destroy all elements and give all chunks back */
+	void Empty()
+	{
+		while(Count)
+		{
+			Count--;
+			(*this)[Count].~T();
+		}
+
+		while(ChunkCount)
+		{
+			RemoveChunk();
+		}
+	}
+
+	/* contiguous per chunk access */
+	size_t NumChunks() const { return (Count + ChunkSize - 1) / ChunkSize; }
+	T* GetChunk(size_t Index) { return Chunks[Index]; }
+	const T* GetChunk(size_t Index) const { return Chunks[Index]; }
+	size_t ChunkNum(size_t Index) const { return Index + 1 < NumChunks() ? ChunkSize : Count - Index * ChunkSize; }
+
+	/* call Func(T* Items, size_t Num) for every chunk in order */
+	template < typename TFunc> void ForEachChunk(TFunc Func)
+	{
+		for(size_t i = 0; i < NumChunks(); i++)
+		{
+			Func(Chunks[i], ChunkNum(i));
+		}
+	}
+
+	template < typename TArrayType, typename TItem> class TIterator
+	{
+	public:
+		TIterator(TArrayType* InArray, size_t InIndex) : Array(InArray), Index(InIndex) {}
+
+		TItem& operator * () const { return (*Array)[Index]; }
+		TItem* operator -> () const { return &(*Array)[Index]; }
+		TIterator& operator ++ () { Index++; return *this; }
+		bool operator != (const TIterator& Other) const { return Index != Other.Index; }
+		bool operator == (const TIterator& Other) const { return Index == Other.Index; }
+
+	private:
+		TArrayType* Array;
+		size_t Index;
+	};
+
+	typedef TIterator<TArray, T> Iterator;
+	typedef TIterator<const TArray, const T> ConstIterator;
+
+	Iterator begin() { return Iterator(this, 0); }
+	Iterator end() { return Iterator(this, Count); }
+	ConstIterator begin() const { return ConstIterator(this, 0); }
+	ConstIterator end() const { return ConstIterator(this, Count); }
+
+private:
+	typedef SFPool<sizeof(T) * ChunkSize, ChunksPerPage, alignof(T)> FPool;
+
+	void Reset()
+	{
+		Pool = nullptr;
+		Chunks = nullptr;
+		ChunkCount = 0;
+		ChunkCapacity = 0;
+		Count = 0;
+	}
+
+	void AddChunk()
+	{
+		if(Pool == nullptr)
+		{
+			Pool = new FPool();
+		}
+
+		if(ChunkCount == ChunkCapacity)
+		{
+			size_t Capacity = ChunkCapacity ? ChunkCapacity * 2 : 8;
+			T** NewChunks = (T**)realloc(Chunks, Capacity * sizeof(T*));
+
+			if(NewChunks == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+
+			Chunks = NewChunks;
+			ChunkCapacity = Capacity;
+		}
+
+		T* Chunk = (T*)Pool->Alloc();
+
+		if(Chunk == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		Chunks[ChunkCount++] = Chunk;
+	}
+
+	void RemoveChunk()
+	{
+		Pool->Free(Chunks[--ChunkCount]);
+	}
+
+	/* on the heap, so the pages which point to it stay valid when the array is moved */
+	FPool* Pool = nullptr;
+	T** Chunks = nullptr;
+	size_t ChunkCount = 0;
+	size_t ChunkCapacity = 0;
+	size_t Count = 0;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <new>
+#include "../sfpool_mt.h"
+
+/* pages each size class may grow to, see FCoroFrameAllocator */
+#ifndef SFPOOL_CORO_MAX_PAGES
+#define SFPOOL_CORO_MAX_PAGES (1 << 16)
+#endif
+
+/*
+ * coroutine frame allocator. frames are served from a few size classes,
+ * each one backed by a concurrent pool, and every thread keeps a small
+ * cache of free frames per class in front of it. a frame which is
+ * destroyed on the thread that created it goes back to that thread's
+ * cache, and a frame destroyed somewhere else lands in the cache of that
+ * thread instead; every frame of a class is interchangeable, so no frame
+ * has to find its way home. frames larger than the largest class go to
+ * the global heap.
+ *
+ * a class holds at most SFPOOL_CORO_MAX_PAGES pages of frames. once its
+ * pool is exhausted, frames of the class come from the global heap too.
+ * such a frame is marked in the word before it, where a frame of a pool
+ * keeps its page, so it is never given to a pool.
+ *
+ * frames are aligned like the memory of a global operator new, see
+ * __STDCPP_DEFAULT_NEW_ALIGNMENT__.
+ *
+ * use it by deriving a promise from FPooledPromise:
+ *
+ *     struct promise_type : FPooledPromise { ... };
+ */
+class FCoroFrameAllocator
+{
+public:
+	static constexpr size_t MinClassSize = 64;
+	static constexpr size_t ClassCount = 7;				/* 64 .. 4096 bytes */
+	static constexpr size_t FramesPerPage = 64;
+	static constexpr size_t MaxPages = SFPOOL_CORO_MAX_PAGES;
+	static constexpr size_t CacheSize = 64;				/* frames per class and thread */
+	static constexpr size_t FrameAlign = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+	static void* Alloc(size_t Size)
+	{
+		size_t Class = ClassOf(Size);
+
+		if(Class == ClassCount)
+		{
+			return ::operator new(Size);
+		}
+
+		FCache& Cache = GetCache();
+
+		if(Cache.Count[Class] != 0)
+		{
+			return Cache.Frames[Class][--Cache.Count[Class]];
+		}
+
+		void* Frame = sfpool_mt_alloc(&GetPools().Pools[Class]);
+
+		if(Frame == nullptr)
+		{
+			return AllocHeap(Class);
+		}
+
+		return Frame;
+	}
+
+	static void Free(void* Frame, size_t Size)
+	{
+		size_t Class = ClassOf(Size);
+
+		if(Class == ClassCount)
+		{
+			::operator delete(Frame);
+			return;
+		}
+
+		FCache& Cache = GetCache();
+
+		if(Cache.Count[Class] != CacheSize)
+		{
+			Cache.Frames[Class][Cache.Count[Class]++] = Frame;
+			return;
+		}
+
+		Release(Class, Frame);
+	}
+
+	/* true if a frame of a size class came from the global heap */
+	static bool IsHeapFrame(void* Frame)
+	{
+		return ((size_t*) Frame)[-1] == HeapMark;
+	}
+
+	/* the pool of a size class, for statistics */
+	static struct sfpool_mt* GetPool(size_t Class) { return &GetPools().Pools[Class]; }
+
+	static size_t ClassOf(size_t Size)
+	{
+		size_t Class = 0;
+
+		while(Class != ClassCount && (MinClassSize << Class) < Size)
+		{
+			Class++;
+		}
+
+		return Class;
+	}
+
+private:
+	/* a page address is never 1 */
+	static constexpr size_t HeapMark = 1;
+
+	/* a frame of the whole class, so it can be cached and reused like any other */
+	static void* AllocHeap(size_t Class)
+	{
+		char* Base = (char*) ::operator new((MinClassSize << Class) + FrameAlign);
+		void* Frame = Base + FrameAlign;
+
+		((size_t*) Frame)[-1] = HeapMark;
+
+		return Frame;
+	}
+
+	/* give a frame back to where it came from */
+	static void Release(size_t Class, void* Frame)
+	{
+		if(IsHeapFrame(Frame))
+		{
+			::operator delete((char*) Frame - FrameAlign);
+			return;
+		}
+
+		sfpool_mt_free(&GetPools().Pools[Class], Frame);
+	}
+
+	struct FPools
+	{
+		FPools()
+		{
+			for(size_t i = 0; i < ClassCount; i++)
+			{
+				if(sfpool_mt_create_aligned(&Pools[i], MinClassSize << i, FramesPerPage, MaxPages, FrameAlign) != 0)
+				{
+					throw std::bad_alloc();
+				}
+			}
+		}
+
+		/* never destroyed, frames may still be alive while static objects go away */
+		struct sfpool_mt Pools[ClassCount];
+	};
+
+	struct FCache
+	{
+		/* a thread which goes away gives its cached frames back to the pools */
+		~FCache()
+		{
+			for(size_t i = 0; i < ClassCount; i++)
+			{
+				while(Count[i] != 0)
+				{
+					Release(i, Frames[i][--Count[i]]);
+				}
+			}
+		}
+
+		void* Frames[ClassCount][CacheSize];
+		size_t Count[ClassCount] = {};
+	};
+
+	static FPools& GetPools()
+	{
+		static FPools* Pools = new FPools();
+		return *Pools;
+	}
+
+	static FCache& GetCache()
+	{
+		thread_local FCache Cache;
+		return Cache;
+	}
+};
+
+/* promise base which makes the coroutine frame come from FCoroFrameAllocator */
+struct FPooledPromise
+{
+	static void* operator new(size_t Size)
+	{
+		return FCoroFrameAllocator::Alloc(Size);
+	}
+
+	static void operator delete(void* Frame, size_t Size)
+	{
+		FCoroFrameAllocator::Free(Frame, Size);
+	}
+};
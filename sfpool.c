@@ -1,4 +1,612 @@
+/* for posix_memalign() and clock_gettime(), and MAP_ANONYMOUS */
+#define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE
+
 #include "sfpool.h"
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+/*
+ * the page map is a global three level radix tree which maps every
+ * SFPOOL_MAP_GRANULE bytes of address space that is covered by a page
+ * to that page. pages are allocated on a granule boundary, so two pages
+ * never share a granule and a lookup needs one load per level.
+ * nodes are created with compare and swap and never freed, so pools
+ * which live in different threads can register their pages at the same time.
+ */
+#define MAP_LEVEL_BITS      12
+#define MAP_FANOUT          ((size_t) 1 << MAP_LEVEL_BITS)
+#define MAP_ADDRESS_BITS    48
+
+static void* map_root[MAP_FANOUT];
+
+/*
+ * get the slot of the granule which holds 'address'. if 'create' is zero
+ * and the path does not exist, or the address is out of the mapped
+ * range, or a node could not be allocated, it returns NULL.
+ */
+static void** map_slot (uintptr_t address,int create)
+{
+    uint64_t key = (uint64_t) address;
+
+    if((key >> MAP_ADDRESS_BITS) != 0)
+    {
+        return NULL;
+    }
+
+    key >>= SFPOOL_MAP_GRANULE_SHIFT;
+
+    void** node = map_root;
+
+    for(int level = 2;level > 0;level--)
+    {
+        size_t index = (size_t) (key >> (MAP_LEVEL_BITS * level)) & (MAP_FANOUT - 1);
+        void* child = __atomic_load_n(&node[index],__ATOMIC_ACQUIRE);
+
+        if(child == NULL)
+        {
+            if(!create)
+            {
+                return NULL;
+            }
+
+            void* fresh = calloc(MAP_FANOUT,sizeof(void*));
+
+            if(fresh == NULL)
+            {
+                return NULL;
+            }
+
+            /* another thread may have created it in the meantime */
+            if(__atomic_compare_exchange_n(&node[index],&child,fresh,0,
+                                           __ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+            {
+                child = fresh;
+            }
+            else
+            {
+                free(fresh);
+            }
+        }
+
+        node = (void**) child;
+    }
+
+    return &node[key & (MAP_FANOUT - 1)];
+}
+
+/*
+ * map every granule of [start,start + size) to 'entry', a page or a slab.
+ * a slab is tagged by setting the lowest bit of its address.
+ */
+static bool_t map_set (void* start,size_t size,void* entry)
+{
+    uintptr_t first = (uintptr_t) start & ~((uintptr_t) SFPOOL_MAP_GRANULE - 1);
+    uintptr_t last = (uintptr_t) start + size - 1;
+
+    for(uintptr_t it = first;it <= last && it >= first;it += SFPOOL_MAP_GRANULE)
+    {
+        void** slot = map_slot(it,entry != NULL);
+
+        if(slot == NULL)
+        {
+            /* there is nothing to clear, or we're out of memory */
+            if(entry == NULL)
+            {
+                continue;
+            }
+
+            map_set((void*) first,it - first,NULL);
+            return 0;
+        }
+
+        __atomic_store_n(slot,entry,__ATOMIC_RELEASE);
+    }
+
+    return 1;
+}
+
+/*
+ * the number of bytes before the first header of a page, without its color.
+ * it puts the first block (a word after its header) on 'block_align'.
+ */
+static size_t page_offset (struct sfpool* pool)
+{
+    return pool->block_align - sizeof(size_t);
+}
+
+/* the number of bytes of block storage of a page, without its color */
+static size_t page_raw_size (struct sfpool* pool)
+{
+    return (sizeof(size_t) + pool->block_size) * pool->page_size + page_offset(pool);
+}
+
+/*
+ * get the block storage of the page. pages of a slab have no color, other
+ * pages start on a granule boundary and the color of a page is always
+ * smaller than a granule, so it is found by rounding down the first header.
+ */
+static void* page_storage (struct sfpool_page* page)
+{
+    if(page->pool->slab_stride != 0)
+    {
+        return (char*) page->headers - page_offset(page->pool);
+    }
+
+    return (void*) ((uintptr_t) page->headers & ~((uintptr_t) SFPOOL_MAP_GRANULE - 1));
+}
+
+/* the number of bytes of block storage that the given page takes */
+static size_t page_size_of (struct sfpool_page* page)
+{
+    return page_raw_size(page->pool) - page_offset(page->pool) +
+           (size_t) ((char*) page->headers - (char*) page_storage(page));
+}
+
+/*
+ * get 'size' bytes of block storage on a granule boundary. pages of a pool
+ * which asks for it are mapped, mapped memory is zeroed and the system page
+ * is at least a granule.
+ */
+static void* storage_alloc (struct sfpool* pool,size_t size)
+{
+    void* storage = NULL;
+
+    if(pool->page_mapped)
+    {
+        storage = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+
+        return storage == MAP_FAILED ? NULL : storage;
+    }
+
+    if(posix_memalign(&storage,SFPOOL_MAP_GRANULE,size) != 0)
+    {
+        return NULL;
+    }
+
+    return storage;
+}
+
+static void storage_free (struct sfpool* pool,void* storage,size_t size)
+{
+    if(pool->page_mapped)
+    {
+        munmap(storage,size);
+    }
+    else
+    {
+        free(storage);
+    }
+}
+
+/*
+ * a slab holds the storage of a number of small pages of one pool, so they
+ * do not each start on a granule boundary. the page map maps the granules
+ * of a slab to the slab, and the slab maps a position to its page.
+ */
+struct sfpool_slab
+{
+    struct sfpool* pool;
+
+    /* slabs of the pool which have a free page */
+    struct sfpool_slab* prev;
+    struct sfpool_slab* next;
+
+    char* storage;
+    size_t size;
+
+    /* number of pages the slab can hold, pages in use, and where to look for a free one */
+    size_t page_count;
+    size_t used;
+    size_t hint;
+
+    struct sfpool_page* pages[];
+};
+
+#define SLAB_TAG ((uintptr_t) 1)
+
+static void slab_unlink (struct sfpool* pool,struct sfpool_slab* slab)
+{
+    if(slab->prev) slab->prev->next = slab->next;
+    if(slab->next) slab->next->prev = slab->prev;
+
+    if(pool->slabs == slab)
+    {
+        pool->slabs = slab->next;
+    }
+
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static void slab_link (struct sfpool* pool,struct sfpool_slab* slab)
+{
+    slab->prev = NULL;
+    slab->next = pool->slabs;
+
+    if(pool->slabs != NULL)
+    {
+        pool->slabs->prev = slab;
+    }
+
+    pool->slabs = slab;
+}
+
+static struct sfpool_slab* slab_new (struct sfpool* pool)
+{
+    size_t size = pool->slab_size;
+    size_t count = size / pool->slab_stride;
+    struct sfpool_slab* slab = (struct sfpool_slab*)
+                               calloc(1,sizeof(struct sfpool_slab) + count * sizeof(struct sfpool_page*));
+
+    if(slab == NULL)
+    {
+        return NULL;
+    }
+
+    if(posix_memalign((void**) &slab->storage,SFPOOL_MAP_GRANULE,size) != 0)
+    {
+        free(slab);
+        return NULL;
+    }
+
+    if(!map_set(slab->storage,size,(void*) ((uintptr_t) slab | SLAB_TAG)))
+    {
+        free(slab->storage);
+        free(slab);
+        return NULL;
+    }
+
+    slab->pool = pool;
+    slab->size = size;
+    slab->page_count = count;
+
+    /* the next slab is twice as large */
+    if(pool->slab_size < SFPOOL_SLAB_MAX)
+    {
+        pool->slab_size *= 2;
+    }
+
+    slab_link(pool,slab);
+
+    return slab;
+}
+
+/*
+ * get the storage of a new page. pages of a slab are registered in the
+ * page map through their slab, other pages are registered themselves.
+ */
+static char* page_storage_new (struct sfpool* pool,struct sfpool_page* page,size_t size)
+{
+    if(pool->slab_stride == 0)
+    {
+        /* the storage starts on a granule boundary, see the page map */
+        char* storage = (char*) storage_alloc(pool,size);
+
+        if(storage != NULL && !map_set(storage,size,page))
+        {
+            storage_free(pool,storage,size);
+            return NULL;
+        }
+
+        return storage;
+    }
+
+    struct sfpool_slab* slab = pool->slabs;
+
+    if(slab == NULL)
+    {
+        slab = slab_new(pool);
+
+        if(slab == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    /* there is a free position, find it */
+    size_t pos = slab->hint;
+
+    while(slab->pages[pos] != NULL)
+    {
+        pos = (pos + 1) % slab->page_count;
+    }
+
+    __atomic_store_n(&slab->pages[pos],page,__ATOMIC_RELEASE);
+    slab->hint = (pos + 1) % slab->page_count;
+    slab->used++;
+
+    if(slab->used == slab->page_count)
+    {
+        slab_unlink(pool,slab);
+    }
+
+    return slab->storage + pos * pool->slab_stride;
+}
+
+/* give the storage of a page back, and its slab once all of its pages are gone */
+static void page_storage_delete (struct sfpool* pool,struct sfpool_page* page)
+{
+    char* storage = (char*) page_storage(page);
+
+    if(pool->slab_stride == 0)
+    {
+        map_set(storage,page_size_of(page),NULL);
+        storage_free(pool,storage,page_size_of(page));
+        return;
+    }
+
+    void** slot = map_slot((uintptr_t) storage,0);
+    struct sfpool_slab* slab = (struct sfpool_slab*) ((uintptr_t) *slot & ~SLAB_TAG);
+    size_t pos = (size_t) (storage - slab->storage) / pool->slab_stride;
+
+    __atomic_store_n(&slab->pages[pos],NULL,__ATOMIC_RELEASE);
+
+    /* a full slab has a free page again */
+    if(slab->used == slab->page_count)
+    {
+        slab_link(pool,slab);
+    }
+
+    slab->used--;
+    slab->hint = pos;
+
+    if(slab->used == 0)
+    {
+        slab_unlink(pool,slab);
+        map_set(slab->storage,slab->size,NULL);
+        free(slab->storage);
+        free(slab);
+    }
+}
+
+/* find the page which holds 'address' from the page map, or NULL */
+static struct sfpool_page* page_of_address (uintptr_t address)
+{
+    void** slot = map_slot(address,0);
+
+    if(slot == NULL)
+    {
+        return NULL;
+    }
+
+    uintptr_t entry = (uintptr_t) __atomic_load_n(slot,__ATOMIC_ACQUIRE);
+
+    if((entry & SLAB_TAG) == 0)
+    {
+        return (struct sfpool_page*) entry;
+    }
+
+    /* the granule belongs to a slab, the position in it gives the page */
+    struct sfpool_slab* slab = (struct sfpool_slab*) (entry & ~SLAB_TAG);
+    size_t pos = (size_t) (address - (uintptr_t) slab->storage) / slab->pool->slab_stride;
+
+    if(pos >= slab->page_count)
+    {
+        return NULL;
+    }
+
+    return __atomic_load_n(&slab->pages[pos],__ATOMIC_ACQUIRE);
+}
+
+/*
+ * take a page descriptor from the descriptor table of the pool.
+ * descriptors live in a few large tables apart from the block storage,
+ * each table twice as large as the previous one. so page level work,
+ * like walking the page list, touches densely packed cache lines
+ * instead of the head of every page's storage.
+ */
+static struct sfpool_page* new_descriptor (struct sfpool* pool)
+{
+    if(pool->free_descriptors == NULL)
+    {
+        size_t index = pool->table_count;
+
+        if(index == SFPOOL_TABLE_COUNT)
+        {
+            return NULL;
+        }
+
+        size_t count = (size_t) SFPOOL_TABLE_FIRST << index;
+        struct sfpool_page* table = NULL;
+
+        if(posix_memalign((void**) &table,SFPOOL_CACHE_LINE,
+                          count * sizeof(struct sfpool_page)) != 0)
+        {
+            return NULL;
+        }
+
+        /* put them in the free list backward, so they are taken in order */
+        for(size_t i = count;i > 0;i--)
+        {
+            table[i - 1].next = pool->free_descriptors;
+            pool->free_descriptors = &table[i - 1];
+        }
+
+        pool->tables[index] = table;
+        pool->table_count++;
+    }
+
+    struct sfpool_page* page = pool->free_descriptors;
+    pool->free_descriptors = page->next;
+
+    return page;
+}
+
+/* give a page descriptor back to the descriptor table */
+static void delete_descriptor (struct sfpool* pool,struct sfpool_page* page)
+{
+    page->next = pool->free_descriptors;
+    pool->free_descriptors = page;
+}
+
+int sfpool_budget_create (struct sfpool_budget* budget,size_t limit,
+                          enum SFPOOL_BUDGET_POLICY policy,long timeout_ms,
+                          sfpool_reclaim_fn reclaim,void* reclaim_ctx)
+{
+    memset(budget,0,sizeof(struct sfpool_budget));
+
+    budget->limit = limit;
+    budget->policy = policy;
+    budget->timeout_ms = timeout_ms;
+    budget->reclaim = reclaim;
+    budget->reclaim_ctx = reclaim_ctx;
+
+    if(pthread_mutex_init(&budget->lock,NULL) != 0)
+    {
+        return -1;
+    }
+
+    /* the timeout of SFPOOL_BUDGET_WAIT must not follow the wall clock */
+    pthread_condattr_t attr;
+
+    if(pthread_condattr_init(&attr) != 0)
+    {
+        pthread_mutex_destroy(&budget->lock);
+        return -1;
+    }
+
+    if(pthread_condattr_setclock(&attr,CLOCK_MONOTONIC) != 0 ||
+       pthread_cond_init(&budget->released,&attr) != 0)
+    {
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_destroy(&budget->lock);
+        return -1;
+    }
+
+    pthread_condattr_destroy(&attr);
+
+    return 0;
+}
+
+void sfpool_budget_destroy (struct sfpool_budget* budget)
+{
+    pthread_cond_destroy(&budget->released);
+    pthread_mutex_destroy(&budget->lock);
+}
+
+/*
+ * take 'size' bytes from the budget of the pool for a new page. if the
+ * budget is exhausted the policy of the budget decides what happens.
+ */
+static bool_t budget_charge (struct sfpool* pool,size_t size)
+{
+    struct sfpool_budget* budget = pool->budget;
+    struct timespec deadline;
+
+    if(budget == NULL)
+    {
+        return 1;
+    }
+
+    if(budget->policy == SFPOOL_BUDGET_WAIT)
+    {
+        clock_gettime(CLOCK_MONOTONIC,&deadline);
+
+        deadline.tv_sec += budget->timeout_ms / 1000;
+        deadline.tv_nsec += (budget->timeout_ms % 1000) * 1000000;
+
+        if(deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&budget->lock);
+
+    while(size > budget->limit || budget->used > budget->limit - size)
+    {
+        /* waiting can not help a page which never fits */
+        if(budget->policy == SFPOOL_BUDGET_FAIL || size > budget->limit)
+        {
+            pthread_mutex_unlock(&budget->lock);
+            return 0;
+        }
+
+        if(budget->policy == SFPOOL_BUDGET_WAIT)
+        {
+            /* wait for a pool of the group to give a page back */
+            if(pthread_cond_timedwait(&budget->released,&budget->lock,&deadline) == ETIMEDOUT &&
+               budget->used > budget->limit - size)
+            {
+                pthread_mutex_unlock(&budget->lock);
+                return 0;
+            }
+
+            continue;
+        }
+
+        /*
+         * SFPOOL_BUDGET_RECLAIM: the callback frees blocks, maybe of this
+         * very pool, which gives pages back to the budget. so it must be
+         * called without the lock. if it could not free anything, or what
+         * it freed did not give a page back, we fail.
+         */
+        size_t needed = size - (budget->limit - budget->used);
+        size_t used = budget->used;
+
+        pthread_mutex_unlock(&budget->lock);
+
+        if(budget->reclaim == NULL || budget->reclaim(pool,needed,budget->reclaim_ctx) == 0)
+        {
+            return 0;
+        }
+
+        pthread_mutex_lock(&budget->lock);
+
+        if(budget->used >= used)
+        {
+            pthread_mutex_unlock(&budget->lock);
+            return 0;
+        }
+    }
+
+    budget->used += size;
+
+    pthread_mutex_unlock(&budget->lock);
+
+    return 1;
+}
+
+/* give the bytes of a page back to the budget and wake up the waiters */
+static void budget_release (struct sfpool* pool,size_t size)
+{
+    struct sfpool_budget* budget = pool->budget;
+
+    if(budget == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&budget->lock);
+    budget->used -= size;
+    pthread_cond_broadcast(&budget->released);
+    pthread_mutex_unlock(&budget->lock);
+}
+
+void sfpool_set_budget (struct sfpool* pool,struct sfpool_budget* budget)
+{
+    size_t size = 0;
+
+    /* move the pages we already have from the old budget to the new one */
+    for(struct sfpool_page* page = pool->first_page;page != NULL;page = page->next)
+    {
+        size += page_raw_size(pool);
+    }
+
+    budget_release(pool,size);
+
+    pool->budget = budget;
+
+    if(budget != NULL)
+    {
+        pthread_mutex_lock(&budget->lock);
+        budget->used += size;
+        pthread_mutex_unlock(&budget->lock);
+    }
+}
 
 /*
  * round the given size by system word size (word size is 4 bytes in 32-bits
@@ -22,10 +630,66 @@ static size_t round_size (size_t size)
     return size;
 }
 
+/* decide how the storage of the pages of a pool is laid out */
+static void page_layout (struct sfpool* pool)
+{
+    size_t raw_size = page_raw_size(pool);
+
+    pool->slab_stride = 0;
+    pool->slab_size = 0;
+    pool->color_count = 1;
+
+    /*
+     * small pages share slabs, a granule of their own would waste most of it.
+     * mapped pages are not carved, a page of a slab may be used before.
+     */
+    if(raw_size <= SFPOOL_MAP_GRANULE / 2 && !pool->page_mapped)
+    {
+        /* the next page must start on 'block_align' as well */
+        pool->slab_stride = (raw_size + pool->block_align - 1) / pool->block_align * pool->block_align;
+        pool->slab_size = SFPOOL_MAP_GRANULE;
+
+        /* pages of a slab are shifted against each other already, they have no color */
+        return;
+    }
+
+    if(!pool->coloring)
+    {
+        return;
+    }
+
+    /*
+     * pages start on a granule boundary, so block N of every page would
+     * map to the same cache sets. each page shifts its blocks by a number
+     * of cache lines (its color), as many as fit in the slack between the
+     * end of the page and the next granule boundary.
+     */
+    size_t slack = (SFPOOL_MAP_GRANULE - raw_size % SFPOOL_MAP_GRANULE) % SFPOOL_MAP_GRANULE;
+
+    pool->color_count = slack / SFPOOL_CACHE_LINE + 1;
+}
+
 void sfpool_create (struct sfpool* pool,size_t block_size,size_t page_size,enum SFPOOL_EXPAND_TYPE expand_type)
+{
+    sfpool_create_aligned(pool,block_size,page_size,sizeof(size_t),expand_type);
+}
+
+int sfpool_create_aligned (struct sfpool* pool,size_t block_size,size_t page_size,
+                           size_t align,enum SFPOOL_EXPAND_TYPE expand_type)
 {
     memset(pool,0,sizeof(struct sfpool));
 
+    if(align < sizeof(size_t))
+    {
+        align = sizeof(size_t);
+    }
+
+    /* colors shift pages by cache lines and pages start on a granule */
+    if((align & (align - 1)) != 0 || align > SFPOOL_CACHE_LINE)
+    {
+        return -1;
+    }
+
     /*
      * round the size of each block according to system word size and put
      * some extra bytes (paddings) in order to make each block start
@@ -33,15 +697,69 @@ void sfpool_create (struct sfpool* pool,size_t block_size,size_t page_size,enum
      * performance. but on the other hand it wastes memory as well.
      */
     pool->block_size = round_size(block_size);
+    pool->block_align = align;
     pool->page_size = page_size;
     pool->expand_type = expand_type;
 
+    /* a block and its header together must keep the next block aligned */
+    while((sizeof(size_t) + pool->block_size) % align != 0)
+    {
+        pool->block_size += sizeof(size_t);
+    }
+
     /*
      * 'distance' is the distance between this header and next header.
      * the size is not actually in bytes, but it rather was divided
      * by sizeof(size_t) to make 'header' address increased by.
      */
     pool->block_distance = (sizeof(size_t) + pool->block_size) / sizeof(size_t);
+
+    pool->coloring = 1;
+    page_layout(pool);
+
+    return 0;
+}
+
+int sfpool_set_page_mapped (struct sfpool* pool,bool_t page_mapped)
+{
+    /* pages which exist already are given back the way they were taken */
+    if(pool->page_count != 0)
+    {
+        return -1;
+    }
+
+    pool->page_mapped = page_mapped;
+    page_layout(pool);
+
+    return 0;
+}
+
+int sfpool_set_coloring (struct sfpool* pool,bool_t coloring)
+{
+    /* the storage of existing pages depends on their color */
+    if(pool->page_count != 0)
+    {
+        return -1;
+    }
+
+    pool->coloring = coloring;
+    pool->next_color = 0;
+    page_layout(pool);
+
+    return 0;
+}
+
+int sfpool_set_zero_on_free (struct sfpool* pool,bool_t zero_on_free)
+{
+    /* free blocks which exist already were not zeroed */
+    if(pool->page_count != 0)
+    {
+        return -1;
+    }
+
+    pool->zero_on_free = zero_on_free;
+
+    return 0;
 }
 
 void sfpool_destroy (struct sfpool* pool)
@@ -62,27 +780,58 @@ void sfpool_destroy (struct sfpool* pool)
     while(it != NULL)
     {
         next = it->next;
-        free(it);
+        budget_release(pool,page_raw_size(pool));
+        page_storage_delete(pool,it);
         it = next;
     }
+
+    /* free the descriptor tables */
+    for(size_t i = 0;i < pool->table_count;i++)
+    {
+        free(pool->tables[i]);
+    }
 }
 
 static struct sfpool_page* add_page (struct sfpool* pool,
                                      enum SFPOOL_EXPAND_TYPE expand_type)
 {
-    size_t raw_size = ((sizeof(size_t) + pool->block_size) * pool->page_size) +
-                      sizeof(struct sfpool_page);
+    size_t color = pool->next_color;
+    size_t raw_size = page_raw_size(pool) + color * SFPOOL_CACHE_LINE;
+    struct sfpool_page* page = NULL;
+    char* storage = NULL;
+
+    /* check if the budget of the pool allows another page, colors are not charged */
+    if(!budget_charge(pool,page_raw_size(pool)))
+    {
+        return NULL;
+    }
 
-    struct sfpool_page* page = (struct sfpool_page*) malloc(raw_size);
+    page = new_descriptor(pool);
 
     if(page == NULL)
     {
+        budget_release(pool,page_raw_size(pool));
+        return NULL;
+    }
+
+    storage = page_storage_new(pool,page,raw_size);
+
+    if(storage == NULL)
+    {
+        delete_descriptor(pool,page);
+        budget_release(pool,page_raw_size(pool));
         return NULL;
     }
 
     /* initialize the new page */
     page->pool = pool;
 
+    /* the blocks are shifted by the page's color */
+    page->headers = (size_t*) (storage + page_offset(pool) + color * SFPOOL_CACHE_LINE);
+
+    /* the next page gets the next color */
+    pool->next_color = (color + 1) % pool->color_count;
+
     /* add this page after the last page */
     page->next = NULL;
     page->prev = pool->last_page;
@@ -112,8 +861,10 @@ static struct sfpool_page* add_page (struct sfpool* pool,
         pool->free_pages->prev_free = page;
     }
 
-    page->block_count = pool->page_size;
-    page->free_count = pool->page_size;
+    /* all blocks are fresh, none of them is touched before it is handed out */
+    page->free_first = NULL;
+    page->fresh = 0;
+    page->free_count = (uint32_t) pool->page_size;
 
     pool->last_page = page;
     pool->free_pages = page;
@@ -121,35 +872,6 @@ static struct sfpool_page* add_page (struct sfpool* pool,
     pool->block_count += pool->page_size;
     pool->page_count++;
 
-    /* generate the free blocks */
-    size_t* header = (size_t*) &page->blocks;
-    size_t* header_next = NULL;
-
-    for(size_t i = 0;i < (pool->page_size - 1);i++)
-    {
-        /* address of the next block header */
-        header_next = header + pool->block_distance;
-
-        /* put the address of the next block header in the block header */
-        *header = (size_t) header_next;
-        
-        /*
-         * put the address of the page in the block's free space.
-         * because no one still uses the block's free space
-         * hence we store the address of the block's owner page
-         * in there. this address will be used by
-         * sfpool_it_next() and sfpool_it_prev().
-         */
-        *(header + 1) = (size_t) page;
-
-        /* goto next header */
-        header = header_next;
-    }
-
-    /* the last free header must point to NULL */
-    *header = 0x0;
-    page->free_first = (size_t*) &page->blocks;
-
     return page;
 }
 
@@ -174,98 +896,216 @@ static void delete_page (struct sfpool* pool,struct sfpool_page* page)
     /* if this page is the first free page */
     if(pool->free_pages == page)
     {
-        pool->free_pages = page->next;
+        pool->free_pages = page->next_free;
     }
 
-    pool->block_count -= page->block_count;
+    pool->block_count -= pool->page_size;
     pool->page_count--;
+
+    budget_release(pool,page_raw_size(pool));
+    page_storage_delete(pool,page);
+    delete_descriptor(pool,page);
 }
 
-void* sfpool_alloc (struct sfpool* pool)
+/*
+ * get the page which the next block is taken from. it switches pages,
+ * and adds new ones, until the current page has a free block.
+ */
+/*
+ * a reclaim callback may free blocks of this very pool without giving a
+ * whole page back, so the budget still fails. get the page it freed into.
+ */
+static struct sfpool_page* reclaimed_page (struct sfpool* pool)
 {
-    /* get the current working page */
     struct sfpool_page* page = pool->free_pages;
 
-    /* check if we already have a free page */
-    if(page != NULL)
+    if(page != NULL && page->free_count != 0)
+    {
+        return page;
+    }
+
+    return NULL;
+}
+
+static struct sfpool_page* alloc_page (struct sfpool* pool)
+{
+    /* switch pages until we can allocate a block */
+    while(1)
     {
+        /* get the current working page */
+        struct sfpool_page* page = pool->free_pages;
+
+        /* check if we already have a free page */
+        if(page != NULL)
+        {
+            /*
+             * check if the page has any free blocks to be allocated,
+             * if so, then allocate it !
+             */
+
+            if(page->free_count != 0)
+            {
+                return page;
+            }
+        }
+
         /*
-         * check if the page has any free blocks to be allocated,
-         * if so, then allocate it !
+         *  it seems that we don't have any free pages!
+         *  this only happens when:
+         *
+         *  - first time of calling sfpool_alloc()
+         *  - we have already freed all the pages.
+         *  - all pages are full.
+         *  - add_page() has failed.
          */
 
-        if(page->free_count != 0)
+        /* if the reason that we're here is page == NULL */
+        if(page == NULL)
         {
-            /* get the address of the first free block */
-            size_t* block = (size_t*) page->free_first;
+            /* request a new page */
+            page = add_page(pool,pool->expand_type);
 
-            /*
-             * mark the first free block as used ,
-             * then put the next free block as the new first free block.
-             */
-            page->free_count--;
-            page->free_first = (size_t*) *block;
+            /* if the requested page could not be created for any reason */
+            if(page == NULL)
+            {
+                return reclaimed_page(pool);
+            }
 
-            /* 
-             * put the address of the page in the header of the block.
-             * this will be useful when we want to free an block.
-             */
-            *block = (size_t) page;
-    
-            /* the block lives just a word size after the header :) */
-            return (void*) (block + 1);
-         }
+            continue;
+        }
+
+        /* check if there is a next free page */
+        if(page->next_free != NULL)
+        {
+           /*
+            * put this page out of our free page list
+            * and replace it with the next free page
+            */
+
+            page->next_free->prev_free = NULL;
+            pool->free_pages = page->next_free;
+
+            page->next_free = NULL;
+            page->prev_free = NULL;
+
+            continue;
+        }
+        /* if there is not any pages then create a new one */
+        else
+        {
+            /* request a new page */
+            page = add_page(pool,pool->expand_type);
+
+            /* if the requested page could not be created for any reason */
+            if(page == NULL)
+            {
+                return reclaimed_page(pool);
+            }
+
+            continue;
+        }
+    }
+}
+
+/*
+ * take a block of a page which has a free one. 'fresh' is set to non-zero
+ * if the block was never handed out before.
+ */
+static void* take_block (struct sfpool_page* page,bool_t* fresh)
+{
+    /* get the address of the first free block */
+    size_t* block = (size_t*) page->free_first;
+
+    if(block != NULL)
+    {
+        /* put the next free block as the new first free block */
+        page->free_first = (size_t*) *block;
+        *fresh = 0;
+    }
+    else
+    {
+        /* the free list is empty, so the page still has fresh blocks */
+        block = page->headers + page->pool->block_distance * page->fresh;
+        page->fresh++;
+        *fresh = 1;
     }
 
+    /* mark the block as used */
+    page->free_count--;
+
     /*
-     *  it seems that we don't have any free pages!
-     *  this only happens when:
-     *
-     *  - first time of calling sfpool_alloc()
-     *  - we have already freed all the pages.
-     *  - all pages are full.
-     *  - add_page() has failed.
+     * put the address of the page in the header of the block.
+     * this will be useful when we want to free an block.
      */
+    *block = (size_t) page;
+
+    /* the block lives just a word size after the header :) */
+    return (void*) (block + 1);
+}
+
+void* sfpool_alloc (struct sfpool* pool)
+{
+    struct sfpool_page* page = alloc_page(pool);
+    bool_t fresh;
 
-    /* if the reason that we're here is page == NULL */
     if(page == NULL)
     {
-        /* request a new page */
-        page = add_page(pool,pool->expand_type);
-
-        return sfpool_alloc(pool);
+        return NULL;
     }
 
-    /* check if there is a next free page */
-    if(page->next_free != NULL)
-    {
-       /*
-        * put this page out of our free page list
-        * and replace it with the next free page
-        */
+    return take_block(page,&fresh);
+}
 
-        page->next_free->prev_free = NULL;
-        pool->free_pages = page->next_free;
+void* sfpool_calloc (struct sfpool* pool)
+{
+    struct sfpool_page* page = alloc_page(pool);
+    bool_t fresh;
+
+    if(page == NULL)
+    {
+        return NULL;
+    }
 
-        page->next_free = NULL;
-        page->prev_free = NULL;
+    void* block = take_block(page,&fresh);
 
-        return sfpool_alloc(pool);
+    /*
+     * a fresh block of a mapped page was never written since the system
+     * gave us zeroed memory, and a free block of a pool which zeroes on
+     * free was cleared by sfpool_free() already, which counted it.
+     */
+    if(fresh && pool->page_mapped)
+    {
+        pool->zero_saved += pool->block_size;
     }
-    /* if there is not any pages then create a new one */
-    else
+    else if(fresh || !pool->zero_on_free)
     {
-        /* request a new page */
-        page = add_page(pool,pool->expand_type);
+        memset(block,0,pool->block_size);
+        pool->zero_cleared += pool->block_size;
+    }
 
-        /* if the requested page could not be created for any reason */
-        if(page == NULL)
-        {
-            return NULL;
-        }
+    return block;
+}
+
+/*
+ * put a page back to the front of the free page list, if it is not there.
+ * sfpool_alloc() drops pages which are full from the list, so a page has
+ * to come back once a block of it is freed, or that block is never reused.
+ */
+static void relink_page (struct sfpool* pool,struct sfpool_page* page)
+{
+    if(page->prev_free != NULL || pool->free_pages == page)
+    {
+        return;
+    }
 
-        return sfpool_alloc(pool);
+    page->next_free = pool->free_pages;
+
+    if(pool->free_pages != NULL)
+    {
+        pool->free_pages->prev_free = page;
     }
+
+    pool->free_pages = page;
 }
 
 void sfpool_free (struct sfpool* pool,void* block)
@@ -283,23 +1123,146 @@ void sfpool_free (struct sfpool* pool,void* block)
      */
     *header = (size_t) page->free_first;
 
-    /*
-     * put the address of the page in the block's free space.
-     * because no one still uses the block's free space
-     * hence we store the address of the block's owner page
-     * in there. this address will be used by
-     * sfpool_it_next() and sfpool_it_prev().
-     */
-    *(header + 1) = (size_t) page;
+    if(pool->zero_on_free)
+    {
+        /* clear it now, so sfpool_calloc() does not have to */
+        memset(block,0,pool->block_size);
+        pool->zero_cleared += pool->block_size;
+    }
+    else
+    {
+        /*
+         * put the address of the page in the block's free space.
+         * because no one still uses the block's free space
+         * hence we store the address of the block's owner page
+         * in there. this address will be used by
+         * sfpool_it_next() and sfpool_it_prev().
+         */
+        *(header + 1) = (size_t) page;
+    }
 
     page->free_first = header;
     page->free_count++;
 
     /* if the owner page is entirely free */
-    if(page->free_count == page->block_count)
+    if(page->free_count == pool->page_size)
     {
         delete_page(pool,page);
     }
+    /* the page was full, it may have been dropped from the free page list */
+    else if(page->free_count == 1)
+    {
+        relink_page(pool,page);
+    }
+}
+
+size_t sfpool_sweep (struct sfpool* pool,sfpool_predicate_fn predicate,void* ctx)
+{
+    struct sfpool_page* page = pool->first_page;
+    size_t distance = pool->block_distance;
+    size_t count = 0;
+
+    while(page != NULL)
+    {
+        /* the page may be deleted below, so get the next one first */
+        struct sfpool_page* next = page->next;
+        size_t* header = page->headers;
+        size_t* free_first = page->free_first;
+        size_t freed = 0;
+
+        /* walk through all blocks of the page once, fresh ones are never used */
+        for(size_t pos = 0;pos < page->fresh;pos++,header += distance)
+        {
+            /* if the header is a used kind and the block has to go */
+            if(*header == (size_t) page && predicate(header + 1,ctx))
+            {
+                /* see sfpool_free() */
+                *header = (size_t) free_first;
+
+                if(pool->zero_on_free)
+                {
+                    memset(header + 1,0,pool->block_size);
+                    pool->zero_cleared += pool->block_size;
+                }
+                else
+                {
+                    *(header + 1) = (size_t) page;
+                }
+
+                free_first = header;
+                freed++;
+            }
+        }
+
+        /* update the page once for all blocks freed in it */
+        if(freed != 0)
+        {
+            page->free_first = free_first;
+            page->free_count += (uint32_t) freed;
+            count += freed;
+
+            /* the page is entirely free, now that we're done with it */
+            if(page->free_count == pool->page_size)
+            {
+                delete_page(pool,page);
+            }
+            else
+            {
+                relink_page(pool,page);
+            }
+        }
+
+        page = next;
+    }
+
+    return count;
+}
+
+struct sfpool* sfpool_owner (void* block)
+{
+    struct sfpool_page* page = page_of_address((uintptr_t) block);
+
+    if(page == NULL)
+    {
+        return NULL;
+    }
+
+    /*
+     * the granule may be shared with memory that is not ours, and the
+     * pointer may point into the middle of a block or to a free one.
+     */
+    struct sfpool* pool = page->pool;
+    size_t first = (size_t) (page->headers + 1);
+    size_t distance = pool->block_distance * sizeof(size_t);
+    size_t address = (size_t) block;
+
+    if(address < first || address >= first + distance * page->fresh ||
+       (address - first) % distance != 0)
+    {
+        return NULL;
+    }
+
+    /* header's data is an address to the owner page if it is used */
+    if(*(((size_t*) block) - 1) != (size_t) page)
+    {
+        return NULL;
+    }
+
+    return pool;
+}
+
+bool_t sfpool_free_any (void* block)
+{
+    struct sfpool* pool = sfpool_owner(block);
+
+    if(pool == NULL)
+    {
+        return 0;
+    }
+
+    sfpool_free(pool,block);
+
+    return 1;
 }
 
 void sfpool_dump (struct sfpool* pool)
@@ -307,15 +1270,15 @@ void sfpool_dump (struct sfpool* pool)
     /* print status of memory pool */
     printf(
     "== SFPOOL ==\n"
-    "block_size     : %u\n"
-    "block_count    : %u\n"
-    "page_count     : %u\n"
+    "block_size     : %lu\n"
+    "block_count    : %lu\n"
+    "page_count     : %lu\n"
     "expand_type  : %u\n"
     "============\n",
-    pool->block_size,
-    pool->block_count,
-    pool->page_count,
-    pool->expand_type);
+    (unsigned long) pool->block_size,
+    (unsigned long) pool->block_count,
+    (unsigned long) pool->page_count,
+    (unsigned int) pool->expand_type);
 
     struct sfpool_page* page = pool->first_page;
     size_t* header = 0;
@@ -323,16 +1286,16 @@ void sfpool_dump (struct sfpool* pool)
     /* iterator through all pages ... */
     for(size_t i = 0;i < pool->page_count;i++)
     {
-        printf("PAGE { %p : ",page);
+        printf("PAGE { %p : ",(void*) page);
 
         /* get first block header of the page */
-        header = (size_t*) &page->blocks;
+        header = page->headers;
 
         /* walk through all blocks and print whether if they're used or not */
-        for(size_t count = 0;count < page->block_count;count++)
+        for(size_t count = 0;count < pool->page_size;count++)
         {
-            /* this block is used */
-            if(*header == (size_t) page)
+            /* this block is used, fresh blocks are free and not read */
+            if(count < page->fresh && *header == (size_t) page)
             {
                 printf("1");
             }
@@ -357,7 +1320,7 @@ static size_t* next_used (struct sfpool_page* page,size_t* header,
                          size_t *the_pos)
 {
     size_t pos = *the_pos;
-    size_t max = page->block_count;
+    size_t max = page->fresh;
     size_t distance = page->pool->block_distance;
 
     while(1)
@@ -389,9 +1352,9 @@ static size_t* next_used (struct sfpool_page* page,size_t* header,
         }
 
         /* now start from first header block of the page */
-        header = (size_t*) &page->blocks;
+        header = page->headers;
         pos = 0;
-        max = page->block_count;
+        max = page->fresh;
     }
 
     return NULL;
@@ -431,9 +1394,9 @@ static size_t* prev_used (struct sfpool_page* page,size_t* header,size_t *the_po
             break;
         }
 
-        /* now start from last header block of the page */
-        pos = page->block_count - 1;
-        header = (size_t*) ((&page->blocks) + (distance * pos));
+        /* now start from last header block of the page which was ever used */
+        pos = page->fresh - 1;
+        header = page->headers + (distance * pos);
     }
 
     return NULL;
@@ -451,7 +1414,7 @@ void* sfpool_it_first (struct sfpool* pool,struct sfpool_it* it)
     }
 
     /* get first block header of the page */
-    size_t* header = (size_t*) &page->blocks;
+    size_t* header = page->headers;
     size_t pos = 0;
 
     /* find first used block header after the current block header */
@@ -489,8 +1452,8 @@ void* sfpool_it_last (struct sfpool* pool,struct sfpool_it* it)
     }
 
     /* get last block header of the page */
-    size_t* header = (size_t*) (&page->blocks) + (pool->block_distance * (page->block_count - 1));
-    size_t pos = page->block_count - 1;
+    size_t pos = page->fresh - 1;
+    size_t* header = page->headers + (pool->block_distance * pos);
 
     /* find first used block header after the current block header */
     header = prev_used(page,header,&pos);
@@ -516,7 +1479,7 @@ void* sfpool_it_last (struct sfpool* pool,struct sfpool_it* it)
     return NULL;
 }
 
-void* sfpool_it_block (struct sfpool* pool,struct sfpool_it* it,void* block)
+void* sfpool_it_from (struct sfpool* pool,struct sfpool_it* it,void* block)
 {
     struct sfpool_page* page;
     size_t* header = ((size_t*) block ) - 1;
@@ -526,7 +1489,7 @@ void* sfpool_it_block (struct sfpool* pool,struct sfpool_it* it,void* block)
     page = (struct sfpool_page*) *header;
     
     /* get position of the header in the page */
-    pos = (((size_t) header) - ((size_t) &page->blocks)) / (sizeof(size_t) + pool->block_size);
+    pos = (((size_t) header) - ((size_t) page->headers)) / (sizeof(size_t) + pool->block_size);
 
     /* save the current status into the iterator object */
     it->page = page;
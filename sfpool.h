@@ -20,6 +20,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,6 +28,30 @@ extern "C" {
 
 typedef size_t bool_t;
 
+/*
+ * pages are registered in a global page map with this granularity,
+ * see sfpool_owner().
+ */
+#define SFPOOL_MAP_GRANULE_SHIFT 12
+#define SFPOOL_MAP_GRANULE       ((size_t) 1 << SFPOOL_MAP_GRANULE_SHIFT)
+
+/* blocks of each page are shifted by a multiple of this, see sfpool_create() */
+#define SFPOOL_CACHE_LINE 64
+
+/*
+ * page descriptors are kept in up to SFPOOL_TABLE_COUNT tables, the first
+ * one holds SFPOOL_TABLE_FIRST descriptors and each next one twice as many.
+ */
+#define SFPOOL_TABLE_FIRST 64
+#define SFPOOL_TABLE_COUNT 32
+
+/*
+ * pages of at most half a granule are carved out of slabs, which start on a
+ * granule boundary instead of each page. the first slab of a pool is one
+ * granule and each next one twice as large, up to SFPOOL_SLAB_MAX bytes.
+ */
+#define SFPOOL_SLAB_MAX (16 * SFPOOL_MAP_GRANULE)
+
 enum SFPOOL_EXPAND_TYPE
 {
     SFPOOL_EXPAND_TYPE_ONE = 0,
@@ -35,23 +60,109 @@ enum SFPOOL_EXPAND_TYPE
 };
 
 struct sfpool_page;
+struct sfpool_slab;
+struct sfpool;
+
+/* what sfpool_alloc() does when the budget of the pool is exhausted */
+enum SFPOOL_BUDGET_POLICY
+{
+    /* return NULL at once */
+    SFPOOL_BUDGET_FAIL = 0,
+    /* wait up to 'timeout_ms' for another pool of the budget to give a page back */
+    SFPOOL_BUDGET_WAIT = 1,
+    /* call 'reclaim' and retry, as long as it reports that it has freed something */
+    SFPOOL_BUDGET_RECLAIM = 2,
+};
+
+/*
+ * a reclaim callback gets the pool which needs memory and the number of
+ * bytes missing. it frees blocks of pools of the budget and returns non-zero
+ * if it has freed anything. it may free blocks of the given pool as well.
+ * the allocation fails if the callback did not give any page back.
+ */
+typedef bool_t (*sfpool_reclaim_fn) (struct sfpool* pool,size_t needed,void* ctx);
+
+/* a sweep predicate returns non-zero if the given block has to be freed */
+typedef bool_t (*sfpool_predicate_fn) (void* block,void* ctx);
+
+/*
+ * byte budget of one pool or a group of pools. every page a pool adds is
+ * taken from the budget and every page it deletes is given back. a page is
+ * charged its blocks and headers, the cache line padding of its color is
+ * not counted. the pools
+ * of a group may live in different threads, the budget has its own lock.
+ */
+struct sfpool_budget
+{
+    size_t limit;
+    size_t used;
+
+    enum SFPOOL_BUDGET_POLICY policy;
+    long timeout_ms;
+
+    sfpool_reclaim_fn reclaim;
+    void* reclaim_ctx;
+
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+};
 
 struct sfpool
 {
     size_t block_size;
     size_t block_count;
     size_t block_distance;
+    size_t block_align;
 
     size_t page_count;
     size_t page_size;
 
     enum SFPOOL_EXPAND_TYPE expand_type;
 
+    /* number of cache colors, and the color of the next new page */
+    size_t color_count;
+    size_t next_color;
+    /* non-zero if pages are colored, see sfpool_set_coloring() */
+    bool_t coloring;
+
     struct sfpool_page* first_page;
     struct sfpool_page* last_page;
     struct sfpool_page* free_pages;
+
+    /* byte budget of the pool, NULL if it may grow without limit */
+    struct sfpool_budget* budget;
+
+    /* page descriptor tables, and the unused descriptors in them */
+    struct sfpool_page* tables[SFPOOL_TABLE_COUNT];
+    size_t table_count;
+    struct sfpool_page* free_descriptors;
+
+    /*
+     * distance between two pages of a slab, zero if every page has its own
+     * storage. the size of the next slab, and the slabs with a free page.
+     */
+    size_t slab_stride;
+    size_t slab_size;
+    struct sfpool_slab* slabs;
+
+    /* non-zero if the pages are mapped, see sfpool_set_page_mapped() */
+    bool_t page_mapped;
+    /* non-zero if freed blocks are zeroed, see sfpool_set_zero_on_free() */
+    bool_t zero_on_free;
+    /*
+     * number of bytes the pool cleared, in sfpool_calloc() or when blocks
+     * were freed, and number of bytes of fresh mapped blocks it did not
+     * have to clear at all.
+     */
+    size_t zero_cleared;
+    size_t zero_saved;
 };
 
+/*
+ * page descriptor. it does not live with the blocks of the page but in a
+ * descriptor table of the pool, and it takes exactly one cache line
+ * on 64-bits systems.
+ */
 struct sfpool_page
 {
     struct sfpool* pool;
@@ -62,12 +173,18 @@ struct sfpool_page
     struct sfpool_page* prev_free;
     struct sfpool_page* next_free;
 
-    size_t block_count;
-    size_t free_count;
-
     size_t* free_first;
 
-    void* blocks;
+    /* first block header, the page's color is already applied to it */
+    size_t* headers;
+
+    /*
+     * blocks from this position on were never handed out. they are not in
+     * the free list, sfpool_alloc() takes them in order once the free list
+     * is empty, and nothing reads them before that.
+     */
+    uint32_t fresh;
+    uint32_t free_count;
 };
 
 /* block iterator. is useful for iterating through blocks */
@@ -92,6 +209,23 @@ struct sfpool_it
 void sfpool_create (struct sfpool* pool,size_t block_size,size_t page_size,
                               enum SFPOOL_EXPAND_TYPE expand_type);
 
+/*
+ * dis: create and initialize a pool object whose blocks start on
+ *      the given alignment
+ *
+ * arg: a pointer to pool object
+ * arg: size of each block of pool
+ * arg: how many blocks a page must maintain?
+ * arg: alignment of each block. a power of two, not larger than
+ *      SFPOOL_CACHE_LINE. smaller than word size means word size.
+ * arg: how should this pool be expanded?
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1 if
+ *      the alignment is not valid.
+ */
+int sfpool_create_aligned (struct sfpool* pool,size_t block_size,size_t page_size,
+                            size_t align,enum SFPOOL_EXPAND_TYPE expand_type);
+
 /*
  * dis: destroy a valid pool object
  *
@@ -101,16 +235,67 @@ void sfpool_create (struct sfpool* pool,size_t block_size,size_t page_size,
  */
 void sfpool_destroy (struct sfpool* pool);
 
+/*
+ * dis: create and initialize a byte budget
+ *
+ * arg: pointer to budget object
+ * arg: how many bytes of pages the pools of the budget may hold together?
+ * arg: what should sfpool_alloc() do when the budget is exhausted?
+ * arg: how long SFPOOL_BUDGET_WAIT may wait, in milliseconds
+ * arg: reclaim callback of SFPOOL_BUDGET_RECLAIM, or NULL
+ * arg: context pointer given to the reclaim callback
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1.
+ */
+int sfpool_budget_create (struct sfpool_budget* budget,size_t limit,
+                          enum SFPOOL_BUDGET_POLICY policy,long timeout_ms,
+                          sfpool_reclaim_fn reclaim,void* reclaim_ctx);
+
+/*
+ * dis: destroy a budget which is not used by any pool anymore
+ *
+ * arg: pointer to budget object
+ *
+ * ret:
+ */
+void sfpool_budget_destroy (struct sfpool_budget* budget);
+
+/*
+ * dis: put a pool under a budget. the pages it already has are moved
+ *      from its old budget to the new one, even beyond the limit.
+ *
+ * arg: pointer to pool object
+ * arg: pointer to budget object, or NULL to remove the budget
+ *
+ * ret:
+ */
+void sfpool_set_budget (struct sfpool* pool,struct sfpool_budget* budget);
+
 /*
  * dis: allocate a new block from memory pool
  *
  * arg: pointer to pool object
  *
  * ret: returns address of the allocated block if function succeeds,
- *      otherwise returns NULL if it fails for any reason.
+ *      otherwise returns NULL if it fails for any reason, also when
+ *      the budget of the pool does not allow another page.
  */
 void* sfpool_alloc (struct sfpool* pool);
 
+/*
+ * dis: allocate a new block from memory pool, filled with zero.
+ *      blocks which are known to be zero are not cleared again: blocks
+ *      of mapped pages which were never handed out, and every free
+ *      block if the pool zeroes blocks when they are freed. see
+ *      sfpool_set_page_mapped() and sfpool_set_zero_on_free().
+ *
+ * arg: pointer to pool object
+ *
+ * ret: returns address of the allocated block if function succeeds,
+ *      otherwise returns NULL, see sfpool_alloc().
+ */
+void* sfpool_calloc (struct sfpool* pool);
+
 /*
  * dis: free an allocated block
  *
@@ -121,6 +306,90 @@ void* sfpool_alloc (struct sfpool* pool);
  */
 void sfpool_free (struct sfpool* pool,void* block);
 
+/*
+ * dis: take the pages of the pool from the system with mmap() instead of
+ *      from the heap. mapped memory is zeroed, so sfpool_calloc() does not
+ *      clear blocks of a page which were never handed out. each page is
+ *      rounded up to a system page and is unmapped once it gets entirely
+ *      free, so it suits pages of a few system pages or more which are
+ *      not emptied and refilled all the time.
+ *      it can only be changed while the pool has no pages.
+ *
+ * arg: pointer to pool object
+ * arg: non-zero to map the pages
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1 if
+ *      the pool has pages already.
+ */
+int sfpool_set_page_mapped (struct sfpool* pool,bool_t page_mapped);
+
+/*
+ * dis: shift the blocks of consecutive pages by a cache line each, so the
+ *      same block of many pages does not map to the same cache sets. it is
+ *      on by default, the colors cost up to a granule of padding per page.
+ *      pages of slabs are never colored.
+ *      it can only be changed while the pool has no pages.
+ *
+ * arg: pointer to pool object
+ * arg: non-zero to color the pages
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1 if
+ *      the pool has pages already.
+ */
+int sfpool_set_coloring (struct sfpool* pool,bool_t coloring);
+
+/*
+ * dis: make sfpool_free() and sfpool_sweep() zero the blocks they free,
+ *      so sfpool_calloc() never has to. the clearing moves from the
+ *      allocation to the free, while the block is likely still in cache.
+ *      it can only be changed while the pool has no pages, free blocks
+ *      of an existing page may not be zero.
+ *
+ * arg: pointer to pool object
+ * arg: non-zero to zero freed blocks
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1 if
+ *      the pool has pages already.
+ */
+int sfpool_set_zero_on_free (struct sfpool* pool,bool_t zero_on_free);
+
+/*
+ * dis: free every allocated block which matches a predicate, in a single
+ *      pass over the pages. each page is walked once, its free blocks
+ *      and counters are updated once, and it is deleted only after it
+ *      has been walked if it got entirely free. use this rather than
+ *      calling sfpool_free() while walking with an iterator.
+ *
+ * arg: pointer to pool object
+ * arg: predicate which is called for every allocated block
+ * arg: context pointer given to the predicate
+ *
+ * ret: number of freed blocks
+ */
+size_t sfpool_sweep (struct sfpool* pool,sfpool_predicate_fn predicate,void* ctx);
+
+/*
+ * dis: find the pool which owns a block. it works for any pointer,
+ *      pointers which are not allocated blocks of a pool are rejected
+ *      after a lookup in the global page map.
+ *
+ * arg: any pointer
+ *
+ * ret: returns the owner pool if the pointer is an allocated block,
+ *      otherwise returns NULL.
+ */
+struct sfpool* sfpool_owner (void* block);
+
+/*
+ * dis: free an allocated block without knowing its pool
+ *
+ * arg: any pointer
+ *
+ * ret: returns 1 if the block was freed, otherwise returns 0 if
+ *      the pointer is not an allocated block of any pool.
+ */
+bool_t sfpool_free_any (void* block);
+
 /*
  * dis: print status of memory pool
  *
@@ -195,8 +464,117 @@ void* sfpool_it_prev (struct sfpool_it* it);
 }
 #endif /* __cplusplus */
 
-class SFPool
+#ifdef __cplusplus
+
+/*
+ * header-only C++ front end of sfpool. the layout is fixed at compile time
+ * and the common case of Alloc() and Free() is inlined into the caller, it
+ * only calls into the library when a page has to be switched, added or
+ * deleted. the object is a plain 'struct sfpool', so blocks may be freed
+ * through either side and GetPool() works with every sfpool_* function.
+ */
+template < size_t BlockSize, size_t BlocksPerPage, size_t Align = sizeof(size_t)> class SFPool
 {
-	void* Alloc();
-	void Free(void* ptr);
-}
\ No newline at end of file
+	static_assert(BlockSize > 0 && BlocksPerPage > 0, "empty blocks or pages");
+	static_assert(BlocksPerPage <= UINT32_MAX, "block counts of a page are 32 bits");
+	static_assert((Align & (Align - 1)) == 0, "alignment must be a power of two");
+	static_assert(Align <= SFPOOL_CACHE_LINE, "alignment larger than a cache line");
+
+public:
+	/* distance between two block headers in words, what sfpool_create_aligned() computes */
+	static constexpr size_t Word = sizeof(size_t);
+	static constexpr size_t Alignment = Align < Word ? Word : Align;
+	static constexpr size_t Distance = ((Word + (BlockSize + Word - 1) / Word * Word + Alignment - 1) / Alignment * Alignment) / Word;
+
+	SFPool()
+	{
+		sfpool_create_aligned(&Pool, BlockSize, BlocksPerPage, Align, SFPOOL_EXPAND_TYPE_ONE);
+	}
+
+	~SFPool()
+	{
+		sfpool_destroy(&Pool);
+	}
+
+	SFPool(const SFPool&) = delete;
+	SFPool& operator = (const SFPool&) = delete;
+
+	struct sfpool* GetPool() { return &Pool; }
+
+	inline void* Alloc()
+	{
+		struct sfpool_page* Page = Pool.free_pages;
+
+		/* see sfpool_alloc() */
+		if(__builtin_expect(Page != nullptr && Page->free_count != 0, 1))
+		{
+			size_t* Block = Page->free_first;
+
+			if(Block != nullptr)
+			{
+				Page->free_first = (size_t*) *Block;
+			}
+			else
+			{
+				Block = Page->headers + Distance * Page->fresh++;
+			}
+
+			Page->free_count--;
+			*Block = (size_t) Page;
+
+			return Block + 1;
+		}
+
+		return AllocSlow();
+	}
+
+	void* Calloc()
+	{
+		return sfpool_calloc(&Pool);
+	}
+
+	inline void Free(void* Block)
+	{
+		size_t* Header = ((size_t*) Block) - 1;
+		struct sfpool_page* Page = (struct sfpool_page*) *Header;
+
+		/*
+		 * see sfpool_free(), the library deletes the page if it gets entirely
+		 * free, puts a full page back to the free page list and zeroes the
+		 * block if the pool asks for it
+		 */
+		if(__builtin_expect(Page->free_count != 0 && Page->free_count + 1 != BlocksPerPage &&
+		                    !Pool.zero_on_free, 1))
+		{
+			*Header = (size_t) Page->free_first;
+			*(Header + 1) = (size_t) Page;
+
+			Page->free_first = Header;
+			Page->free_count++;
+			return;
+		}
+
+		FreeSlow(Block);
+	}
+
+	/* the block at the given position of the page, without any runtime layout fields */
+	static inline void* BlockAt(struct sfpool_page* Page, size_t Pos)
+	{
+		return Page->headers + Distance * Pos + 1;
+	}
+
+private:
+	__attribute__((noinline)) void* AllocSlow()
+	{
+		return sfpool_alloc(&Pool);
+	}
+
+	__attribute__((noinline)) void FreeSlow(void* Block)
+	{
+		sfpool_free(&Pool, Block);
+	}
+
+	struct sfpool Pool;
+};
+
+#endif /* __cplusplus */
@@ -0,0 +1,724 @@
+/* for posix_memalign() */
+#define _POSIX_C_SOURCE 200112L
+
+#include "sfpool_mt.h"
+#include <stddef.h>
+
+/*
+ * all shared fields are accessed with the gcc/clang __atomic builtins,
+ * so the library still builds as C99.
+ */
+#define LOAD(ptr)            __atomic_load_n((ptr),__ATOMIC_SEQ_CST)
+#define STORE(ptr,val)       __atomic_store_n((ptr),(val),__ATOMIC_SEQ_CST)
+#define EXCHANGE(ptr,val)    __atomic_exchange_n((ptr),(val),__ATOMIC_SEQ_CST)
+#define FETCH_ADD(ptr,val)   __atomic_fetch_add((ptr),(val),__ATOMIC_SEQ_CST)
+#define CAS(ptr,expected,desired) \
+    __atomic_compare_exchange_n((ptr),(expected),(desired),0, \
+                                __ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST)
+
+/* build a new tagged head out of an old one and a new (index + 1) */
+#define TAGGED(old,index) \
+    ((((old) + ((uint64_t) 1 << 32)) & ~SFPOOL_MT_INDEX_MASK) | \
+     ((uint64_t) (index) & SFPOOL_MT_INDEX_MASK))
+
+/*
+ * round the given size by system word size (word size is 4 bytes in 32-bits
+ * and 8 bytes in 64-bits systems). we'll use this for address alignment.
+ */
+static size_t round_size (size_t size)
+{
+    if(size < sizeof(size_t))
+    {
+        return sizeof(size_t);
+    }
+
+    size_t mod = size % sizeof(size_t);
+
+    if(mod != 0)
+    {
+        size += sizeof(size_t) - mod;
+    }
+
+    return size;
+}
+
+/* get the first block header of the page */
+static size_t* page_headers (struct sfpool_mt_page* page)
+{
+    return (size_t*) ((char*) page + page->pool->block_offset);
+}
+
+/* get the header of the block at the given position of the page */
+static size_t* page_header (struct sfpool_mt_page* page,size_t pos)
+{
+    return page_headers(page) + (page->pool->block_distance * pos);
+}
+
+int sfpool_mt_create (struct sfpool_mt* pool,size_t block_size,
+                      size_t page_size,size_t max_pages)
+{
+    return sfpool_mt_create_aligned(pool,block_size,page_size,max_pages,sizeof(size_t));
+}
+
+int sfpool_mt_create_aligned (struct sfpool_mt* pool,size_t block_size,
+                              size_t page_size,size_t max_pages,size_t align)
+{
+    memset(pool,0,sizeof(struct sfpool_mt));
+
+    /* block and page indices must fit in the low half of a tagged head */
+    if(page_size == 0 || page_size >= SFPOOL_MT_INDEX_MASK ||
+       max_pages == 0 || max_pages >= SFPOOL_MT_INDEX_MASK)
+    {
+        return -1;
+    }
+
+    if(align < sizeof(size_t))
+    {
+        align = sizeof(size_t);
+    }
+
+    if((align & (align - 1)) != 0 || align > SFPOOL_MT_MAX_ALIGN)
+    {
+        return -1;
+    }
+
+    pool->block_size = round_size(block_size);
+    pool->block_align = align;
+    pool->page_size = page_size;
+    pool->max_pages = max_pages;
+
+    /* a block and its header together must keep the next block aligned */
+    while((sizeof(size_t) + pool->block_size) % align != 0)
+    {
+        pool->block_size += sizeof(size_t);
+    }
+
+    /* see sfpool_create() */
+    pool->block_distance = (sizeof(size_t) + pool->block_size) / sizeof(size_t);
+
+    /* the first block, a word after its header, is aligned as well */
+    size_t first = offsetof(struct sfpool_mt_page,blocks) + sizeof(size_t);
+
+    pool->block_offset = (first + align - 1) / align * align - sizeof(size_t);
+
+    pool->pages = (struct sfpool_mt_page**)
+                  calloc(max_pages,sizeof(struct sfpool_mt_page*));
+
+    if(pool->pages == NULL)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+void sfpool_mt_destroy (struct sfpool_mt* pool)
+{
+    /* check if the memory pool is valid? */
+    if(pool == NULL || pool->pages == NULL)
+    {
+        return;
+    }
+
+    /* free all pages */
+    for(size_t i = 0;i < pool->page_count;i++)
+    {
+        free(pool->pages[i]);
+    }
+
+    /* free all thread records, their retired blocks went with the pages */
+    struct sfpool_mt_thread* thread = pool->threads;
+
+    while(thread != NULL)
+    {
+        struct sfpool_mt_thread* next = thread->next;
+
+        for(size_t i = 0;i < 3;i++)
+        {
+            free(thread->retired[i]);
+        }
+
+        free(thread);
+        thread = next;
+    }
+
+    pool->threads = NULL;
+
+    free(pool->pages);
+    pool->pages = NULL;
+}
+
+/*
+ * push the page to the free page list, unless it is already there.
+ * the 'listed' flag makes sure that a page is never in the list twice.
+ */
+static void publish_page (struct sfpool_mt* pool,struct sfpool_mt_page* page)
+{
+    if(EXCHANGE(&page->listed,1) != 0)
+    {
+        return;
+    }
+
+    uint64_t head = LOAD(&pool->free_pages);
+
+    do
+    {
+        STORE(&page->next_free,(size_t) (head & SFPOOL_MT_INDEX_MASK));
+    }
+    while(!CAS(&pool->free_pages,&head,TAGGED(head,page->index + 1)));
+}
+
+static struct sfpool_mt_page* add_page (struct sfpool_mt* pool)
+{
+    /* claim a slot in the page table */
+    size_t index = LOAD(&pool->page_count);
+
+    do
+    {
+        if(index >= pool->max_pages)
+        {
+            return NULL;
+        }
+    }
+    while(!CAS(&pool->page_count,&index,index + 1));
+
+    size_t raw_size = ((sizeof(size_t) + pool->block_size) * pool->page_size) +
+                      pool->block_offset;
+
+    struct sfpool_mt_page* page = NULL;
+
+    /* the claimed slot just stays empty */
+    if(posix_memalign((void**) &page,pool->block_align,raw_size) != 0)
+    {
+        return NULL;
+    }
+
+    /* initialize the new page */
+    page->pool = pool;
+    page->block_count = pool->page_size;
+    page->free_count = pool->page_size;
+    page->index = index;
+    page->next_free = 0;
+    page->listed = 0;
+
+    /*
+     * generate the free blocks. a free header holds the (position + 1)
+     * of the next free header, the last one holds zero.
+     */
+    size_t* header = page_headers(page);
+
+    for(size_t i = 1;i < pool->page_size;i++)
+    {
+        *header = i + 1;
+        header += pool->block_distance;
+    }
+
+    *header = 0x0;
+    page->free_first = 1;
+
+    FETCH_ADD(&pool->block_count,pool->page_size);
+
+    /* make the page visible to other threads */
+    STORE(&pool->pages[index],page);
+    publish_page(pool,page);
+
+    return page;
+}
+
+/*
+ * reserve one free block of the page. a successful reservation guarantees
+ * that pop_block() finds a block, because sfpool_mt_free() pushes a block
+ * before it makes it reservable.
+ */
+static int reserve_block (struct sfpool_mt_page* page)
+{
+    size_t count = LOAD(&page->free_count);
+
+    while(count != 0)
+    {
+        if(CAS(&page->free_count,&count,count - 1))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static size_t* pop_block (struct sfpool_mt_page* page)
+{
+    uint64_t head = LOAD(&page->free_first);
+    size_t* header;
+
+    do
+    {
+        header = page_header(page,(size_t) (head & SFPOOL_MT_INDEX_MASK) - 1);
+    }
+    /*
+     * the header may be changed by another thread right after we read it,
+     * but then the tag of the head has changed as well and CAS fails.
+     */
+    while(!CAS(&page->free_first,&head,TAGGED(head,LOAD(header))));
+
+    return header;
+}
+
+void* sfpool_mt_alloc (struct sfpool_mt* pool)
+{
+    while(1)
+    {
+        /* get the current working page */
+        uint64_t head = LOAD(&pool->free_pages);
+        size_t index = (size_t) (head & SFPOOL_MT_INDEX_MASK);
+
+        /* we don't have any free pages, request a new one */
+        if(index == 0)
+        {
+            if(add_page(pool) == NULL &&
+               (LOAD(&pool->free_pages) & SFPOOL_MT_INDEX_MASK) == 0)
+            {
+                return NULL;
+            }
+
+            continue;
+        }
+
+        struct sfpool_mt_page* page = LOAD(&pool->pages[index - 1]);
+
+        if(reserve_block(page))
+        {
+            size_t* block = pop_block(page);
+
+            /*
+             * put the address of the page in the header of the block.
+             * this will be useful when we want to free an block.
+             */
+            STORE(block,(size_t) page);
+
+            /* the block lives just a word size after the header :) */
+            return (void*) (block + 1);
+        }
+
+        /* the page is full, put it out of our free page list */
+        if(CAS(&pool->free_pages,&head,TAGGED(head,LOAD(&page->next_free))))
+        {
+            STORE(&page->listed,0);
+
+            /*
+             * a block may have been freed after we have seen the page
+             * full, but before 'listed' was cleared. the thread which
+             * freed it saw the page still listed, so it is our job.
+             */
+            if(LOAD(&page->free_count) != 0)
+            {
+                publish_page(pool,page);
+            }
+        }
+    }
+}
+
+void sfpool_mt_free (struct sfpool_mt* pool,void* block)
+{
+    /* header lives just a word size before the block */
+    size_t* header = ((size_t*) (block)) - 1;
+
+    /* header's data is an address to the owner page */
+    struct sfpool_mt_page* page = (struct sfpool_mt_page*) LOAD(header);
+
+    size_t pos = (size_t) (header - page_headers(page)) / pool->block_distance;
+    uint64_t head = LOAD(&page->free_first);
+
+    /* push the block to the free blocks of the page */
+    do
+    {
+        STORE(header,(size_t) (head & SFPOOL_MT_INDEX_MASK));
+    }
+    while(!CAS(&page->free_first,&head,TAGGED(head,pos + 1)));
+
+    /* if the page was full, it has to go back to the free page list */
+    if(FETCH_ADD(&page->free_count,1) == 0)
+    {
+        publish_page(pool,page);
+    }
+}
+
+size_t sfpool_mt_trim (struct sfpool_mt* pool)
+{
+    size_t released = 0;
+    size_t count = 0;
+    uint64_t head = pool->free_pages;
+
+    /* rebuild the page table and free page list without the empty pages */
+    pool->free_pages = TAGGED(head,0);
+
+    for(size_t i = 0;i < pool->page_count;i++)
+    {
+        struct sfpool_mt_page* page = pool->pages[i];
+
+        pool->pages[i] = NULL;
+
+        /* a slot of a page that could not be created */
+        if(page == NULL)
+        {
+            continue;
+        }
+
+        if(page->free_count == page->block_count)
+        {
+            pool->block_count -= page->block_count;
+            free(page);
+            released++;
+            continue;
+        }
+
+        page->index = count;
+        page->listed = 0;
+        pool->pages[count++] = page;
+
+        if(page->free_count != 0)
+        {
+            publish_page(pool,page);
+        }
+    }
+
+    pool->page_count = count;
+
+    return released;
+}
+
+struct sfpool_mt_thread* sfpool_mt_thread_attach (struct sfpool_mt* pool)
+{
+    struct sfpool_mt_thread* thread;
+
+    /* take a record which was given back by another thread */
+    for(thread = LOAD(&pool->threads);thread != NULL;thread = thread->next)
+    {
+        if(LOAD(&thread->in_use) == 0 && EXCHANGE(&thread->in_use,1) == 0)
+        {
+            return thread;
+        }
+    }
+
+    thread = (struct sfpool_mt_thread*) calloc(1,sizeof(struct sfpool_mt_thread));
+
+    if(thread == NULL)
+    {
+        return NULL;
+    }
+
+    thread->pool = pool;
+    thread->in_use = 1;
+
+    /* records are never removed from the list, so pushing is enough */
+    struct sfpool_mt_thread* head = LOAD(&pool->threads);
+
+    do
+    {
+        thread->next = head;
+    }
+    while(!CAS(&pool->threads,&head,thread));
+
+    return thread;
+}
+
+void sfpool_mt_thread_detach (struct sfpool_mt_thread* thread)
+{
+    sfpool_mt_reclaim(thread);
+    STORE(&thread->in_use,0);
+}
+
+void sfpool_mt_epoch_enter (struct sfpool_mt_thread* thread)
+{
+    if(thread->nesting++ != 0)
+    {
+        return;
+    }
+
+    /*
+     * announce the epoch we have seen. this is a sequentially consistent
+     * store, so it is visible to try_advance() before we read any block.
+     */
+    STORE(&thread->local,(LOAD(&thread->pool->epoch) << 1) | 1);
+}
+
+void sfpool_mt_epoch_exit (struct sfpool_mt_thread* thread)
+{
+    if(--thread->nesting != 0)
+    {
+        return;
+    }
+
+    STORE(&thread->local,0);
+}
+
+/*
+ * move the global epoch one step forward, if every thread which is inside
+ * a critical section has already seen the current epoch.
+ */
+static size_t try_advance (struct sfpool_mt* pool)
+{
+    size_t epoch = LOAD(&pool->epoch);
+
+    for(struct sfpool_mt_thread* it = LOAD(&pool->threads);it != NULL;it = it->next)
+    {
+        size_t local = LOAD(&it->local);
+
+        if((local & 1) != 0 && (local >> 1) != epoch)
+        {
+            return epoch;
+        }
+    }
+
+    /* if CAS fails another thread has moved it already */
+    if(CAS(&pool->epoch,&epoch,epoch + 1))
+    {
+        epoch++;
+    }
+
+    return epoch;
+}
+
+/* give the retired list 'i' back to the pages */
+static size_t free_retired (struct sfpool_mt_thread* thread,size_t i)
+{
+    size_t count = thread->retired_count[i];
+
+    for(size_t j = 0;j < count;j++)
+    {
+        sfpool_mt_free(thread->pool,thread->retired[i][j]);
+    }
+
+    thread->retired_count[i] = 0;
+
+    return count;
+}
+
+size_t sfpool_mt_reclaim (struct sfpool_mt_thread* thread)
+{
+    size_t epoch = try_advance(thread->pool);
+    size_t count = 0;
+
+    thread->pending = 0;
+
+    /* blocks retired two epochs ago can not be held by anyone */
+    for(size_t i = 0;i < 3;i++)
+    {
+        if(thread->retired_count[i] != 0 && thread->retired_epoch[i] + 2 <= epoch)
+        {
+            count += free_retired(thread,i);
+        }
+    }
+
+    return count;
+}
+
+void sfpool_mt_free_deferred (struct sfpool_mt_thread* thread,void* block)
+{
+    size_t epoch = LOAD(&thread->pool->epoch);
+    size_t i = epoch % 3;
+
+    /*
+     * the list of this slot was filled at least three epochs ago.
+     * it is safe to be freed, then the slot is reused for this epoch.
+     */
+    if(thread->retired_epoch[i] != epoch)
+    {
+        free_retired(thread,i);
+        thread->retired_epoch[i] = epoch;
+    }
+
+    /*
+     * the block may still be read by other threads, so we can not link
+     * it through its own memory. keep it in a growing array instead.
+     */
+    if(thread->retired_count[i] == thread->retired_size[i])
+    {
+        size_t size = thread->retired_size[i] ? thread->retired_size[i] * 2 :
+                                                SFPOOL_MT_RETIRE_BATCH;
+        void** retired = (void**) realloc(thread->retired[i],size * sizeof(void*));
+
+        /*
+         * we have no place to keep it. we can not tell when it is safe
+         * to be freed, so it is better to never give it back.
+         */
+        if(retired == NULL)
+        {
+            return;
+        }
+
+        thread->retired[i] = retired;
+        thread->retired_size[i] = size;
+    }
+
+    thread->retired[i][thread->retired_count[i]++] = block;
+
+    if(++thread->pending >= SFPOOL_MT_RETIRE_BATCH)
+    {
+        sfpool_mt_reclaim(thread);
+    }
+}
+
+/*
+ * take a snapshot of used blocks of the page. free blocks are exactly the
+ * blocks in the free block stack, and a header of a block in the stack
+ * only changes after it is popped, which bumps the tag. so if the head is
+ * the same before and after the walk, we have walked the stack as it was
+ * at that moment. until then the walk may follow garbage, it is checked
+ * against the page boundary and the page size.
+ *
+ * a large page which is busy may change during every walk, so the walks
+ * are bounded. if no walk succeeds, no block of the page is reported.
+ */
+static int snapshot_page (struct sfpool_mt_page* page,uint64_t* used)
+{
+    size_t words = (page->block_count + 63) / 64;
+
+    for(size_t tries = 0;tries < SFPOOL_MT_SNAPSHOT_TRIES;tries++)
+    {
+        uint64_t head = LOAD(&page->free_first);
+        size_t index = (size_t) (head & SFPOOL_MT_INDEX_MASK);
+        size_t steps = 0;
+
+        /* everything is used, until it is found in the free stack */
+        memset(used,0xFF,words * sizeof(uint64_t));
+
+        while(index != 0 && index <= page->block_count &&
+              steps++ < page->block_count)
+        {
+            used[(index - 1) / 64] &= ~((uint64_t) 1 << ((index - 1) % 64));
+            index = LOAD(page_header(page,index - 1));
+        }
+
+        if(LOAD(&page->free_first) == head)
+        {
+            return 1;
+        }
+    }
+
+    memset(used,0,words * sizeof(uint64_t));
+
+    return 0;
+}
+
+/* find the next used block from the position of the iterator */
+static void* it_find (struct sfpool_mt_it* it)
+{
+    struct sfpool_mt* pool = it->pool;
+
+    while(1)
+    {
+        struct sfpool_mt_page* page = it->page;
+
+        /* check if we're still in the page boundary */
+        for(size_t pos = it->block_pos;page != NULL && pos < page->block_count;pos++)
+        {
+            if((it->used[pos / 64] >> (pos % 64)) & 1)
+            {
+                it->block_pos = pos;
+
+                return (void*) (page_header(page,pos) + 1);
+            }
+        }
+
+        /* turn the page, skipping the slots of failed pages */
+        do
+        {
+            it->page_index++;
+
+            if(it->page_index >= LOAD(&pool->page_count))
+            {
+                sfpool_mt_it_release(it);
+                return NULL;
+            }
+
+            it->page = LOAD(&pool->pages[it->page_index]);
+        }
+        while(it->page == NULL);
+
+        if(!snapshot_page(it->page,it->used))
+        {
+            FETCH_ADD(&pool->skipped_pages,1);
+        }
+
+        it->block_pos = 0;
+    }
+}
+
+void* sfpool_mt_it_first (struct sfpool_mt* pool,struct sfpool_mt_it* it)
+{
+    memset(it,0,sizeof(struct sfpool_mt_it));
+
+    it->pool = pool;
+    it->used = (uint64_t*) malloc(((pool->page_size + 63) / 64) * sizeof(uint64_t));
+
+    if(it->used == NULL)
+    {
+        return NULL;
+    }
+
+    /* start before the first page, it_find() turns to it */
+    it->page_index = (size_t) -1;
+
+    return it_find(it);
+}
+
+void* sfpool_mt_it_next (struct sfpool_mt_it* it)
+{
+    if(it->used == NULL)
+    {
+        return NULL;
+    }
+
+    it->block_pos++;
+
+    return it_find(it);
+}
+
+void sfpool_mt_it_release (struct sfpool_mt_it* it)
+{
+    free(it->used);
+
+    /* fill the iterator with zero */
+    memset(it,0,sizeof(struct sfpool_mt_it));
+}
+
+void sfpool_mt_dump (struct sfpool_mt* pool)
+{
+    size_t page_count = LOAD(&pool->page_count);
+
+    /* print status of memory pool */
+    printf(
+    "== SFPOOL_MT ==\n"
+    "block_size     : %lu\n"
+    "block_count    : %lu\n"
+    "page_count     : %lu\n"
+    "max_pages      : %lu\n"
+    "skipped_pages  : %lu\n"
+    "===============\n",
+    (unsigned long) pool->block_size,
+    (unsigned long) LOAD(&pool->block_count),
+    (unsigned long) page_count,
+    (unsigned long) pool->max_pages,
+    (unsigned long) LOAD(&pool->skipped_pages));
+
+    /* iterator through all pages ... */
+    for(size_t i = 0;i < page_count;i++)
+    {
+        struct sfpool_mt_page* page = LOAD(&pool->pages[i]);
+
+        if(page == NULL)
+        {
+            continue;
+        }
+
+        printf("PAGE { %p : ",(void*) page);
+
+        /* walk through all blocks and print whether if they're used or not */
+        for(size_t pos = 0;pos < page->block_count;pos++)
+        {
+            printf(LOAD(page_header(page,pos)) == (size_t) page ? "1" : "0");
+        }
+
+        printf(" }\n");
+    }
+}
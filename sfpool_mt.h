@@ -0,0 +1,351 @@
+/******************************************************************************
+ *           DO WHAT THE FUCK YOU WANT TO PUBLIC LICENSE
+ *                   Version 2, December 2004
+ *
+ *  Copyright (C) 2015 Ali Rahbar <junk0xc0de@tuta.io>
+ *
+ *  Everyone is permitted to copy and distribute verbatim or modified
+ *  copies of this license document, and changing it is allowed as long
+ *  as the name is changed.
+ *
+ *           DO WHAT THE FUCK YOU WANT TO PUBLIC LICENSE
+ *  TERMS AND CONDITIONS FOR COPYING, DISTRIBUTION AND MODIFICATION
+ *
+ *  0. You just DO WHAT THE FUCK YOU WANT TO.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * sfpool_mt is the concurrent variant of sfpool. any number of threads may
+ * call sfpool_mt_alloc() and sfpool_mt_free() on the same pool at the same
+ * time without a lock.
+ *
+ * free blocks of a page and pages with free blocks are both kept in tagged
+ * treiber stacks. a stack head is a 64 bits word: the low 32 bits hold the
+ * (index + 1) of the top entry and the high 32 bits hold a tag that is
+ * bumped on every successful compare and swap, so a head that was popped
+ * and pushed back in between is never mistaken for the old one (ABA).
+ *
+ * pages are never released while the pool is alive. a page that becomes
+ * entirely free stays on the free page list and is reused, so a thread that
+ * is still looking at a page can never touch released memory.
+ * sfpool_mt_trim() gives empty pages back, but only when no other thread
+ * is using the pool.
+ */
+
+#define SFPOOL_MT_INDEX_MASK ((uint64_t) 0xFFFFFFFF)
+
+/* how many blocks a thread retires before it tries to reclaim them */
+#define SFPOOL_MT_RETIRE_BATCH 64
+
+/* largest block alignment, see sfpool_mt_create_aligned() */
+#define SFPOOL_MT_MAX_ALIGN 64
+
+/* how many times an iterator walks a page before it gives up on it */
+#define SFPOOL_MT_SNAPSHOT_TRIES 16
+
+struct sfpool_mt_page;
+struct sfpool_mt_thread;
+
+struct sfpool_mt
+{
+    size_t block_size;
+    size_t block_distance;
+    size_t block_align;
+    /* bytes from the start of a page to its first block header */
+    size_t block_offset;
+
+    size_t page_size;
+    size_t max_pages;
+
+    /* number of claimed slots in 'pages' (atomic) */
+    size_t page_count;
+    /* number of blocks of all pages (atomic) */
+    size_t block_count;
+
+    /* tagged head of the list of pages that have free blocks (atomic) */
+    uint64_t free_pages;
+
+    /* page table, a page is identified by its position in here */
+    struct sfpool_mt_page** pages;
+
+    /* global epoch of deferred free (atomic) */
+    size_t epoch;
+    /* all thread records which were ever attached to the pool (atomic) */
+    struct sfpool_mt_thread* threads;
+
+    /* number of pages iterators skipped, see struct sfpool_mt_it (atomic) */
+    size_t skipped_pages;
+};
+
+struct sfpool_mt_page
+{
+    struct sfpool_mt* pool;
+
+    /* tagged head of the free blocks of this page (atomic) */
+    uint64_t free_first;
+    /* number of free blocks which are not reserved yet (atomic) */
+    size_t free_count;
+    size_t block_count;
+
+    /* position of this page in the page table */
+    size_t index;
+    /* (index + 1) of the next page in the free page list (atomic) */
+    size_t next_free;
+    /* non-zero while the page is in the free page list (atomic) */
+    size_t listed;
+
+    /* block storage, the first header is at 'block_offset' of the pool */
+    void* blocks;
+};
+
+/*
+ * per thread record of epoch based deferred free.
+ *
+ * a thread reads blocks that other threads may free only between
+ * sfpool_mt_epoch_enter() and sfpool_mt_epoch_exit(). blocks which are
+ * given to sfpool_mt_free_deferred() are kept by the thread that retired
+ * them, in one of three lists indexed by (epoch % 3). the global epoch
+ * moves on only when every thread inside a critical section has seen
+ * the current one, so once it is two epochs ahead of a list no one can
+ * hold a block of that list anymore and the whole list goes back to its
+ * pages at once.
+ */
+struct sfpool_mt_thread
+{
+    struct sfpool_mt* pool;
+    struct sfpool_mt_thread* next;
+
+    /* non-zero while a thread owns this record (atomic) */
+    size_t in_use;
+    /* (epoch << 1) | 1 inside a critical section, otherwise 0 (atomic) */
+    size_t local;
+    /* depth of nested sfpool_mt_epoch_enter() calls */
+    size_t nesting;
+
+    /* blocks retired in epoch 'retired_epoch[i]' */
+    void** retired[3];
+    size_t retired_count[3];
+    size_t retired_size[3];
+    size_t retired_epoch[3];
+
+    /* blocks retired since the last reclaim attempt */
+    size_t pending;
+};
+
+/*
+ * block iterator of a concurrent pool. other threads may keep allocating
+ * and freeing while it walks the pool.
+ *
+ * blocks of a page are taken from a snapshot of the page. the snapshot is
+ * made by walking the free blocks of the page, and it is retried until the
+ * tag of the page's free block head did not change during the walk, so it
+ * shows the page as it was at one point in time. a page which changes
+ * during SFPOOL_MT_SNAPSHOT_TRIES walks in a row is skipped as a whole and
+ * counted in 'skipped_pages' of the pool. a block which is reported
+ * may be freed right after, read it between sfpool_mt_epoch_enter() and
+ * sfpool_mt_epoch_exit() and free it with sfpool_mt_free_deferred() if its
+ * content has to stay valid.
+ */
+struct sfpool_mt_it
+{
+    struct sfpool_mt* pool;
+    struct sfpool_mt_page* page;
+    size_t page_index;
+    size_t block_pos;
+
+    /* one bit per block of the current page, set if the block is used */
+    uint64_t* used;
+};
+
+/*
+ * dis: create and initialize a concurrent pool object
+ *
+ * arg: a pointer to pool object
+ * arg: size of each block of pool
+ * arg: how many blocks a page must maintain?
+ * arg: how many pages the pool may grow to?
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1.
+ */
+int sfpool_mt_create (struct sfpool_mt* pool,size_t block_size,
+                      size_t page_size,size_t max_pages);
+
+/*
+ * dis: create and initialize a concurrent pool object whose blocks
+ *      start on the given alignment
+ *
+ * arg: a pointer to pool object
+ * arg: size of each block of pool
+ * arg: how many blocks a page must maintain?
+ * arg: how many pages the pool may grow to?
+ * arg: alignment of each block. a power of two, not larger than
+ *      SFPOOL_MT_MAX_ALIGN. smaller than word size means word size.
+ *
+ * ret: returns 0 if function succeeds, otherwise returns -1.
+ */
+int sfpool_mt_create_aligned (struct sfpool_mt* pool,size_t block_size,
+                              size_t page_size,size_t max_pages,size_t align);
+
+/*
+ * dis: destroy a valid concurrent pool object.
+ *      no other thread may use the pool at the same time.
+ *
+ * arg: a pointer to pool object
+ *
+ * ret:
+ */
+void sfpool_mt_destroy (struct sfpool_mt* pool);
+
+/*
+ * dis: allocate a new block from memory pool. it is safe to call this
+ *      from many threads at the same time.
+ *
+ * arg: pointer to pool object
+ *
+ * ret: returns address of the allocated block if function succeeds,
+ *      otherwise returns NULL if it fails for any reason.
+ */
+void* sfpool_mt_alloc (struct sfpool_mt* pool);
+
+/*
+ * dis: free an allocated block. it is safe to call this from many
+ *      threads at the same time, the block may have been allocated
+ *      by any thread.
+ *
+ * arg: pointer to pool object
+ * arg: pointer to an allocated block
+ *
+ * ret:
+ */
+void sfpool_mt_free (struct sfpool_mt* pool,void* block);
+
+/*
+ * dis: release the pages which are entirely free.
+ *      no other thread may use the pool at the same time.
+ *
+ * arg: pointer to pool object
+ *
+ * ret: number of released pages
+ */
+size_t sfpool_mt_trim (struct sfpool_mt* pool);
+
+/*
+ * dis: get a thread record for deferred free. each thread which uses
+ *      sfpool_mt_epoch_enter() or sfpool_mt_free_deferred() needs its own.
+ *      records of detached threads are reused.
+ *
+ * arg: pointer to pool object
+ *
+ * ret: returns a pointer to the record if function succeeds,
+ *      otherwise returns NULL.
+ */
+struct sfpool_mt_thread* sfpool_mt_thread_attach (struct sfpool_mt* pool);
+
+/*
+ * dis: give a thread record back to the pool. the thread must not be
+ *      inside a critical section. retired blocks which can not be
+ *      reclaimed yet stay in the record until another thread takes it.
+ *
+ * arg: pointer to thread record
+ *
+ * ret:
+ */
+void sfpool_mt_thread_detach (struct sfpool_mt_thread* thread);
+
+/*
+ * dis: enter a critical section. blocks which are freed by
+ *      sfpool_mt_free_deferred() from now on stay valid until the
+ *      thread leaves the section. sections may be nested.
+ *
+ * arg: pointer to thread record
+ *
+ * ret:
+ */
+void sfpool_mt_epoch_enter (struct sfpool_mt_thread* thread);
+
+/*
+ * dis: leave a critical section
+ *
+ * arg: pointer to thread record
+ *
+ * ret:
+ */
+void sfpool_mt_epoch_exit (struct sfpool_mt_thread* thread);
+
+/*
+ * dis: free an allocated block once no thread can hold it anymore.
+ *      the block must already be unreachable for new readers.
+ *
+ * arg: pointer to thread record
+ * arg: pointer to an allocated block
+ *
+ * ret:
+ */
+void sfpool_mt_free_deferred (struct sfpool_mt_thread* thread,void* block);
+
+/*
+ * dis: try to move the global epoch on and give the retired blocks
+ *      of the thread, which are safe by now, back to their pages.
+ *
+ * arg: pointer to thread record
+ *
+ * ret: number of blocks which were given back
+ */
+size_t sfpool_mt_reclaim (struct sfpool_mt_thread* thread);
+
+/*
+ * dis: initialize an iterator from first block of memory pool
+ *
+ * arg: pointer to pool object
+ * arg: pointer to iterator object
+ *
+ * ret: a pointer to first used block of memory pool, or NULL if
+ *      there is not any. when it returns NULL the iterator is
+ *      already released.
+ */
+void* sfpool_mt_it_first (struct sfpool_mt* pool,struct sfpool_mt_it* it);
+
+/*
+ * dis: get the next block
+ *
+ * arg: pointer to iterator object
+ *
+ * ret: a pointer to the next used block. if it exeeds
+ *      the last block then it returns NULL and releases
+ *      the iterator.
+ */
+void* sfpool_mt_it_next (struct sfpool_mt_it* it);
+
+/*
+ * dis: release an iterator which is not walked to its end.
+ *      it is safe to call it more than once.
+ *
+ * arg: pointer to iterator object
+ *
+ * ret:
+ */
+void sfpool_mt_it_release (struct sfpool_mt_it* it);
+
+/*
+ * dis: print status of memory pool
+ *
+ * arg: pointer to pool object
+ *
+ * ret:
+ */
+void sfpool_mt_dump (struct sfpool_mt* pool);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
@@ -5,32 +5,22 @@
 #include <time.h>
 
 #define SIZE (10 * 1024)
-static struct sfpool* pool = NULL;
+static struct sfpool the_pool;
+static struct sfpool* pool = &the_pool;
 static void* ptrs[SIZE];
 
+static bool_t everything (void* block,void* ctx)
+{
+    return 1;
+}
+
 static void sighandler (int signal)
 {
     sfpool_dump(pool);
     printf("now free everything !\n");
-    struct sfpool_it it;
-    void* ptr = sfpool_it_first(pool,&it);
-    while(ptr)
-    {
-        sfpool_free(pool,ptr);
-        ptr = sfpool_it_next(&it);
-    }
+    sfpool_sweep(pool,everything,NULL);
 
     sfpool_dump(pool);
-<<<<<<< HEAD
-	
-<<<<<<< HEAD
-	//get
-	
-=======
->>>>>>> parent of ed169ed... first
-=======
-	//ghjk
->>>>>>> parent of 084f2be... new comment
     exit(0);
 }
 
@@ -95,14 +85,14 @@ int main (void)
     signal(SIGINT,sighandler);
     memset(ptrs,0,sizeof(ptrs));
 
-    pool = sfpool_create (1,32,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_create(pool,1,32,SFPOOL_EXPAND_TYPE_ONE);
 
     srand(clock());
 
     while(1)
     {
         func[rand() % 2]();
-        printf("PAGE : %lu\n",pool->page_count);
+        printf("PAGE : %lu\n",(unsigned long) pool->page_count);
     }
     
     sfpool_dump(pool);
@@ -114,7 +104,7 @@ int main2 (void)
     signal(SIGINT,sighandler);
     memset(ptrs,0,sizeof(ptrs));
 
-    pool = sfpool_create (1,8,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_create(pool,1,8,SFPOOL_EXPAND_TYPE_ONE);
 
     for(int i = 0;i < 9;i++)
     {
@@ -128,14 +118,14 @@ int main2 (void)
     b = sfpool_it_first(pool,&it);
     while(b)
     {   
-        printf("[%p] (%u) = %X\n",it.page,it.block_pos,*b);
+        printf("[%p] (%lu) = %lX\n",(void*) it.page,(unsigned long) it.block_pos,(unsigned long) *b);
         b = sfpool_it_next(&it);
     }
 
-    b = sfpool_it_block(pool,&it,ptrs[8]);
+    b = sfpool_it_from(pool,&it,ptrs[8]);
     while(b)
     {   
-        printf("[%p] (%u) = %X\n",it.page,it.block_pos,*b);
+        printf("[%p] (%lu) = %lX\n",(void*) it.page,(unsigned long) it.block_pos,(unsigned long) *b);
         b = sfpool_it_prev(&it);
     }
 
@@ -0,0 +1,155 @@
+#include "core/array.h"
+#include <assert.h>
+#include <string>
+
+static void test_stable (void)
+{
+	TArray<size_t, 16> Array;
+	size_t* First = &Array.Add(0);
+
+	/* growing never moves an element */
+	for(size_t i = 1; i < 1000; i++)
+	{
+		Array.Add(i);
+	}
+
+	assert(First == &Array[0]);
+	assert(Array.Num() == 1000);
+
+	for(size_t i = 0; i < 1000; i++)
+	{
+		assert(Array[i] == i);
+	}
+
+	/* chunks are contiguous and in order */
+	size_t Next = 0;
+
+	Array.ForEachChunk([&](size_t* Items, size_t Num)
+	{
+		for(size_t i = 0; i < Num; i++)
+		{
+			assert(Items[i] == Next);
+			Next++;
+		}
+	});
+
+	assert(Next == 1000);
+
+	/* popping keeps the remaining elements where they are */
+	size_t* Middle = &Array[500];
+
+	while(Array.Num() > 501)
+	{
+		Array.Pop();
+	}
+
+	assert(Middle == &Array[500]);
+	assert(Array.Last() == 500);
+
+	/* add and pop around a chunk border */
+	for(size_t i = 0; i < 100; i++)
+	{
+		Array.Add(i);
+		Array.Pop();
+	}
+
+	assert(Array.Num() == 501);
+}
+
+static void test_objects (void)
+{
+	TArray<std::string, 4> Array;
+
+	for(int i = 0; i < 50; i++)
+	{
+		Array.Emplace(std::to_string(i));
+	}
+
+	int i = 0;
+
+	for(const std::string& Item : Array)
+	{
+		assert(Item == std::to_string(i));
+		i++;
+	}
+
+	Array.Pop();
+	assert(Array.Last() == "48");
+
+	Array.Empty();
+	assert(Array.IsEmpty());
+	assert(Array.NumChunks() == 0);
+}
+
+static void test_move (void)
+{
+	TArray<std::string, 4> Array;
+
+	for(int i = 0; i < 50; i++)
+	{
+		Array.Emplace(std::to_string(i));
+	}
+
+	std::string* First = &Array[0];
+
+	/* the elements stay where they are, the source is left empty */
+	TArray<std::string, 4> Moved(std::move(Array));
+
+	assert(Array.IsEmpty() && Array.NumChunks() == 0);
+	assert(Moved.Num() == 50);
+	assert(&Moved[0] == First);
+	assert(Moved.Last() == "49");
+
+	/* the source can be used again, with a pool of its own */
+	Array.Add("again");
+	assert(Array.Num() == 1);
+
+	/* assignment gives the old elements of the target back */
+	Array = std::move(Moved);
+
+	assert(Moved.IsEmpty());
+	assert(Array.Num() == 50);
+	assert(&Array[0] == First);
+
+	for(int i = 0; i < 50; i++)
+	{
+		assert(Array[i] == std::to_string(i));
+	}
+
+	Moved.Add("after");
+	Array.Pop();
+	assert(Array.Last() == "48");
+}
+
+struct alignas(32) FVector
+{
+	float X, Y, Z;
+};
+
+static void test_aligned (void)
+{
+	TArray<FVector, 3> Array;
+
+	for(int i = 0; i < 20; i++)
+	{
+		Array.Add(FVector{ (float) i, 0, 0 });
+	}
+
+	/* every element keeps the alignment of its type, in every chunk */
+	for(int i = 0; i < 20; i++)
+	{
+		assert((uintptr_t) &Array[i] % alignof(FVector) == 0);
+		assert(Array[i].X == (float) i);
+	}
+}
+
+int main (void)
+{
+	test_stable();
+	test_objects();
+	test_move();
+	test_aligned();
+
+	printf("test_array: ok\n");
+	return 0;
+}
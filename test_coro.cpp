@@ -0,0 +1,181 @@
+/* small pools, so the tests run out of them */
+#define SFPOOL_CORO_MAX_PAGES 8
+
+#include "core/coroutine.h"
+#include <assert.h>
+#include <coroutine>
+#include <thread>
+#include <vector>
+
+/* a lazy task which runs when resumed and is destroyed by its owner */
+template < typename TPromiseBase> struct TTask
+{
+	struct promise_type : TPromiseBase
+	{
+		int Value = 0;
+
+		TTask get_return_object() { return TTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_value(int InValue) { Value = InValue; }
+		void unhandled_exception() {}
+	};
+
+	explicit TTask(std::coroutine_handle<promise_type> InHandle) : Handle(InHandle) {}
+	TTask(TTask&& Other) : Handle(Other.Handle) { Other.Handle = nullptr; }
+	~TTask() { if(Handle) Handle.destroy(); }
+
+	int Run() { Handle.resume(); return Handle.promise().Value; }
+
+	std::coroutine_handle<promise_type> Handle;
+};
+
+static TTask<FPooledPromise> Add(int A, int B)
+{
+	co_return A + B;
+}
+
+static void test_frames (void)
+{
+	/* size classes */
+	assert(FCoroFrameAllocator::ClassOf(1) == 0);
+	assert(FCoroFrameAllocator::ClassOf(64) == 0);
+	assert(FCoroFrameAllocator::ClassOf(65) == 1);
+	assert(FCoroFrameAllocator::ClassOf(4096) == 6);
+	assert(FCoroFrameAllocator::ClassOf(4097) == FCoroFrameAllocator::ClassCount);
+
+	/* frames come from the pools */
+	size_t Blocks = 0;
+
+	{
+		TTask<FPooledPromise> Task = Add(1, 2);
+
+		for(size_t i = 0; i < FCoroFrameAllocator::ClassCount; i++)
+		{
+			Blocks += FCoroFrameAllocator::GetPool(i)->block_count;
+		}
+
+		assert(Blocks != 0);
+		int Value = Task.Run();
+		assert(Value == 3);
+	}
+
+	/* a destroyed frame is reused by the next coroutine of this thread */
+	void* Frame = Add(1, 2).Handle.address();
+	TTask<FPooledPromise> Task = Add(3, 4);
+
+	assert(Task.Handle.address() == Frame);
+	int Value = Task.Run();
+	assert(Value == 7);
+}
+
+static void test_alignment (void)
+{
+	/* every frame of every class is aligned like a frame of the global operator new */
+	for(size_t i = 0; i < FCoroFrameAllocator::ClassCount; i++)
+	{
+		std::vector<void*> Frames;
+
+		for(size_t j = 0; j < 2 * FCoroFrameAllocator::FramesPerPage; j++)
+		{
+			Frames.push_back(FCoroFrameAllocator::Alloc(FCoroFrameAllocator::MinClassSize << i));
+			assert((size_t) Frames.back() % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+		}
+
+		for(void* Frame : Frames)
+		{
+			FCoroFrameAllocator::Free(Frame, FCoroFrameAllocator::MinClassSize << i);
+		}
+	}
+
+	std::vector<TTask<FPooledPromise>> Tasks;
+
+	for(int i = 0; i < 200; i++)
+	{
+		Tasks.push_back(Add(i, i));
+		assert((size_t) Tasks.back().Handle.address() % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+	}
+}
+
+static void test_exhausted (void)
+{
+	/* a class which runs out of pages takes frames from the global heap */
+	size_t Count = FCoroFrameAllocator::MaxPages * FCoroFrameAllocator::FramesPerPage + 100;
+	size_t Size = FCoroFrameAllocator::MinClassSize << 2;
+	size_t Heap = 0;
+	std::vector<void*> Frames;
+
+	for(size_t i = 0; i < Count; i++)
+	{
+		void* Frame = FCoroFrameAllocator::Alloc(Size);
+
+		assert(Frame != nullptr);
+		assert((size_t) Frame % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+		memset(Frame, 0xFF, Size);
+		Heap += FCoroFrameAllocator::IsHeapFrame(Frame);
+		Frames.push_back(Frame);
+	}
+
+	assert(Heap >= 100);
+
+	/* heap frames are cached and reused like the others, then deleted */
+	for(void* Frame : Frames)
+	{
+		FCoroFrameAllocator::Free(Frame, Size);
+	}
+
+	Frames.clear();
+
+	for(size_t i = 0; i < Count; i++)
+	{
+		Frames.push_back(FCoroFrameAllocator::Alloc(Size));
+	}
+
+	for(void* Frame : Frames)
+	{
+		FCoroFrameAllocator::Free(Frame, Size);
+	}
+}
+
+static void test_threads (void)
+{
+	/* frames made on one thread and destroyed on others */
+	std::vector<TTask<FPooledPromise>> Tasks;
+
+	for(int i = 0; i < 1000; i++)
+	{
+		Tasks.push_back(Add(i, i));
+	}
+
+	std::thread Threads[4];
+
+	for(int t = 0; t < 4; t++)
+	{
+		Threads[t] = std::thread([&Tasks, t]()
+		{
+			for(int i = t; i < 1000; i += 4)
+			{
+				int Value = Tasks[i].Run();
+				assert(Value == 2 * i);
+				Tasks[i].Handle.destroy();
+				Tasks[i].Handle = nullptr;
+			}
+		});
+	}
+
+	for(int t = 0; t < 4; t++)
+	{
+		Threads[t].join();
+	}
+}
+
+int main (void)
+{
+	test_frames();
+	test_alignment();
+	test_exhausted();
+	test_threads();
+
+	printf("test_coro: ok\n");
+	return 0;
+}
@@ -0,0 +1,479 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sfpool_mt.h"
+#include <pthread.h>
+#include <assert.h>
+
+/*
+ * stress test of sfpool_mt. build it with -fsanitize=thread
+ * (make check) to let ThreadSanitizer watch the lock-free paths.
+ */
+
+#define THREADS     8
+#define ROUNDS      2000
+#define BATCH       64
+#define SLOTS       256
+
+static struct sfpool_mt pool;
+
+/* blocks handed over between threads, so they are freed by another thread */
+static void* slots[SLOTS];
+
+static void* worker (void* arg)
+{
+    size_t id = (size_t) arg;
+    size_t* blocks[BATCH];
+    unsigned int seed = (unsigned int) id;
+
+    for(size_t round = 0;round < ROUNDS;round++)
+    {
+        /* allocate a batch and stamp every block with our id */
+        for(size_t i = 0;i < BATCH;i++)
+        {
+            blocks[i] = (size_t*) sfpool_mt_alloc(&pool);
+            assert(blocks[i] != NULL);
+
+            blocks[i][0] = id;
+            blocks[i][1] = i;
+        }
+
+        /* nobody else may have got one of our blocks */
+        for(size_t i = 0;i < BATCH;i++)
+        {
+            assert(blocks[i][0] == id);
+            assert(blocks[i][1] == i);
+        }
+
+        for(size_t i = 0;i < BATCH;i++)
+        {
+            /* hand over some blocks, free what we get back */
+            if(i % 4 == 0)
+            {
+                size_t slot = (size_t) rand_r(&seed) % SLOTS;
+                void* other = __atomic_exchange_n(&slots[slot],(void*) blocks[i],
+                                                  __ATOMIC_ACQ_REL);
+                if(other != NULL)
+                {
+                    sfpool_mt_free(&pool,other);
+                }
+            }
+            else
+            {
+                sfpool_mt_free(&pool,blocks[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void test_stress (void)
+{
+    pthread_t threads[THREADS];
+
+    int ret = sfpool_mt_create(&pool,2 * sizeof(size_t),16,1024);
+    assert(ret == 0);
+
+    for(size_t i = 0;i < THREADS;i++)
+    {
+        pthread_create(&threads[i],NULL,worker,(void*) i);
+    }
+
+    for(size_t i = 0;i < THREADS;i++)
+    {
+        pthread_join(threads[i],NULL);
+    }
+
+    for(size_t i = 0;i < SLOTS;i++)
+    {
+        if(slots[i] != NULL)
+        {
+            sfpool_mt_free(&pool,slots[i]);
+            slots[i] = NULL;
+        }
+    }
+
+    /* every block is free again, so every page can be released */
+    size_t page_count = pool.page_count;
+    size_t released = sfpool_mt_trim(&pool);
+    assert(released == page_count);
+    assert(pool.page_count == 0);
+    assert(pool.block_count == 0);
+
+    /* the pool is still usable after trimming */
+    void* block = sfpool_mt_alloc(&pool);
+    assert(block != NULL);
+    sfpool_mt_free(&pool,block);
+
+    sfpool_mt_destroy(&pool);
+}
+
+static void test_limit (void)
+{
+    void* blocks[4 * 8];
+
+    int ret = sfpool_mt_create(&pool,sizeof(size_t),8,4);
+    assert(ret == 0);
+
+    /* the pool may not grow beyond max_pages */
+    for(size_t i = 0;i < 4 * 8;i++)
+    {
+        blocks[i] = sfpool_mt_alloc(&pool);
+        assert(blocks[i] != NULL);
+    }
+
+    void* full = sfpool_mt_alloc(&pool);
+    assert(full == NULL);
+
+    /* a freed block can be allocated again */
+    sfpool_mt_free(&pool,blocks[13]);
+    blocks[13] = sfpool_mt_alloc(&pool);
+    assert(blocks[13] != NULL);
+
+    for(size_t i = 0;i < 4 * 8;i++)
+    {
+        sfpool_mt_free(&pool,blocks[i]);
+    }
+
+    sfpool_mt_destroy(&pool);
+}
+
+/*
+ * writers keep replacing a shared block and retire the old one with
+ * sfpool_mt_free_deferred(), readers keep checking the current block.
+ * if a block went back to its page while a reader still holds it,
+ * a writer would reuse it and the reader would see a torn pattern
+ * (and ThreadSanitizer would see a data race).
+ */
+static size_t* current;
+static size_t done;
+
+static void* deferred_writer (void* arg)
+{
+    struct sfpool_mt_thread* thread = sfpool_mt_thread_attach(&pool);
+    assert(thread != NULL);
+
+    for(size_t i = 0;i < ROUNDS * 4;i++)
+    {
+        size_t* block = (size_t*) sfpool_mt_alloc(&pool);
+        assert(block != NULL);
+
+        block[0] = i;
+        block[1] = ~i;
+
+        size_t* old = __atomic_exchange_n(&current,block,__ATOMIC_ACQ_REL);
+
+        if(old != NULL)
+        {
+            sfpool_mt_free_deferred(thread,old);
+        }
+    }
+
+    sfpool_mt_thread_detach(thread);
+    return NULL;
+}
+
+static void* deferred_reader (void* arg)
+{
+    struct sfpool_mt_thread* thread = sfpool_mt_thread_attach(&pool);
+    assert(thread != NULL);
+
+    while(!__atomic_load_n(&done,__ATOMIC_ACQUIRE))
+    {
+        sfpool_mt_epoch_enter(thread);
+
+        size_t* block = __atomic_load_n(&current,__ATOMIC_ACQUIRE);
+
+        /* read it a few times, it must not change under our feet */
+        for(size_t i = 0;block != NULL && i < 8;i++)
+        {
+            assert(block[0] == ~block[1]);
+        }
+
+        sfpool_mt_epoch_exit(thread);
+    }
+
+    sfpool_mt_thread_detach(thread);
+    return NULL;
+}
+
+static void test_deferred (void)
+{
+    pthread_t writers[THREADS / 2];
+    pthread_t readers[THREADS / 2];
+
+    int ret = sfpool_mt_create(&pool,2 * sizeof(size_t),16,4096);
+    assert(ret == 0);
+
+    for(size_t i = 0;i < THREADS / 2;i++)
+    {
+        pthread_create(&readers[i],NULL,deferred_reader,NULL);
+        pthread_create(&writers[i],NULL,deferred_writer,NULL);
+    }
+
+    for(size_t i = 0;i < THREADS / 2;i++)
+    {
+        pthread_join(writers[i],NULL);
+    }
+
+    __atomic_store_n(&done,1,__ATOMIC_RELEASE);
+
+    for(size_t i = 0;i < THREADS / 2;i++)
+    {
+        pthread_join(readers[i],NULL);
+    }
+
+    /* with nobody inside a critical section everything is reclaimed */
+    struct sfpool_mt_thread* thread = sfpool_mt_thread_attach(&pool);
+
+    for(size_t i = 0;i < 3;i++)
+    {
+        sfpool_mt_reclaim(thread);
+    }
+
+    sfpool_mt_free(&pool,current);
+
+    /* only the records of 'THREADS' threads were created, then reused */
+    size_t records = 0;
+
+    for(struct sfpool_mt_thread* it = pool.threads;it != NULL;it = it->next)
+    {
+        records++;
+    }
+
+    assert(records <= THREADS);
+
+    sfpool_mt_thread_detach(thread);
+    sfpool_mt_destroy(&pool);
+}
+
+static void test_iterator (void)
+{
+    void* blocks[100];
+    struct sfpool_mt_it it;
+
+    int ret = sfpool_mt_create(&pool,sizeof(size_t),8,64);
+    assert(ret == 0);
+
+    /* an empty pool has nothing to walk through */
+    void* first = sfpool_mt_it_first(&pool,&it);
+    assert(first == NULL);
+
+    for(size_t i = 0;i < 100;i++)
+    {
+        blocks[i] = sfpool_mt_alloc(&pool);
+    }
+
+    /* free every third block */
+    for(size_t i = 0;i < 100;i += 3)
+    {
+        sfpool_mt_free(&pool,blocks[i]);
+        blocks[i] = NULL;
+    }
+
+    /* the iterator must see exactly the used blocks */
+    size_t count = 0;
+
+    for(void* block = sfpool_mt_it_first(&pool,&it);block != NULL;
+        block = sfpool_mt_it_next(&it))
+    {
+        size_t found = 0;
+
+        for(size_t i = 0;i < 100;i++)
+        {
+            found += blocks[i] == block;
+        }
+
+        assert(found == 1);
+        count++;
+    }
+
+    assert(count == 100 - 34);
+
+    /* stop early */
+    first = sfpool_mt_it_first(&pool,&it);
+    assert(first != NULL);
+    sfpool_mt_it_release(&it);
+    sfpool_mt_it_release(&it);
+
+    sfpool_mt_destroy(&pool);
+}
+
+/* scanners walk the pool while the workers of test_stress() churn it */
+static void* scanner (void* arg)
+{
+    struct sfpool_mt_it it;
+
+    while(!__atomic_load_n(&done,__ATOMIC_ACQUIRE))
+    {
+        size_t count = 0;
+
+        for(void* block = sfpool_mt_it_first(&pool,&it);block != NULL;
+            block = sfpool_mt_it_next(&it))
+        {
+            count++;
+        }
+
+        assert(count <= __atomic_load_n(&pool.block_count,__ATOMIC_ACQUIRE));
+    }
+
+    return NULL;
+}
+
+static void test_concurrent_iterator (void)
+{
+    pthread_t threads[THREADS];
+    pthread_t scanners[2];
+
+    int ret = sfpool_mt_create(&pool,2 * sizeof(size_t),16,1024);
+    assert(ret == 0);
+    __atomic_store_n(&done,0,__ATOMIC_RELEASE);
+
+    for(size_t i = 0;i < 2;i++)
+    {
+        pthread_create(&scanners[i],NULL,scanner,NULL);
+    }
+
+    for(size_t i = 0;i < THREADS;i++)
+    {
+        pthread_create(&threads[i],NULL,worker,(void*) i);
+    }
+
+    for(size_t i = 0;i < THREADS;i++)
+    {
+        pthread_join(threads[i],NULL);
+    }
+
+    __atomic_store_n(&done,1,__ATOMIC_RELEASE);
+
+    for(size_t i = 0;i < 2;i++)
+    {
+        pthread_join(scanners[i],NULL);
+    }
+
+    /* at rest, the iterator sees exactly the blocks left in the slots */
+    size_t used = 0;
+    struct sfpool_mt_it it;
+
+    for(size_t i = 0;i < SLOTS;i++)
+    {
+        used += slots[i] != NULL;
+    }
+
+    for(void* block = sfpool_mt_it_first(&pool,&it);block != NULL;
+        block = sfpool_mt_it_next(&it))
+    {
+        used--;
+    }
+
+    assert(used == 0);
+
+    for(size_t i = 0;i < SLOTS;i++)
+    {
+        if(slots[i] != NULL)
+        {
+            sfpool_mt_free(&pool,slots[i]);
+            slots[i] = NULL;
+        }
+    }
+
+    sfpool_mt_destroy(&pool);
+}
+
+/* churners keep changing the free block stack of one large page */
+static void* churner (void* arg)
+{
+    void* blocks[8];
+
+    while(!__atomic_load_n(&done,__ATOMIC_ACQUIRE))
+    {
+        for(size_t i = 0;i < 8;i++)
+        {
+            blocks[i] = sfpool_mt_alloc(&pool);
+            assert(blocks[i] != NULL);
+        }
+
+        for(size_t i = 0;i < 8;i++)
+        {
+            sfpool_mt_free(&pool,blocks[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static void test_busy_page (void)
+{
+    pthread_t threads[4];
+    struct sfpool_mt_it it;
+    void* kept[16];
+
+    /* a single page, a walk of its free blocks takes long enough to be disturbed */
+    int ret = sfpool_mt_create(&pool,2 * sizeof(size_t),4096,1);
+    assert(ret == 0);
+    __atomic_store_n(&done,0,__ATOMIC_RELEASE);
+
+    for(size_t i = 0;i < 16;i++)
+    {
+        kept[i] = sfpool_mt_alloc(&pool);
+    }
+
+    for(size_t i = 0;i < 4;i++)
+    {
+        pthread_create(&threads[i],NULL,churner,NULL);
+    }
+
+    /* every walk ends, whether the page could be taken or was skipped */
+    for(size_t round = 0;round < 200;round++)
+    {
+        size_t count = 0;
+
+        for(void* block = sfpool_mt_it_first(&pool,&it);block != NULL;
+            block = sfpool_mt_it_next(&it))
+        {
+            count++;
+        }
+
+        assert(count <= 16 + 4 * 8);
+    }
+
+    __atomic_store_n(&done,1,__ATOMIC_RELEASE);
+
+    for(size_t i = 0;i < 4;i++)
+    {
+        pthread_join(threads[i],NULL);
+    }
+
+    /* a quiet page is never skipped */
+    size_t skipped = __atomic_load_n(&pool.skipped_pages,__ATOMIC_ACQUIRE);
+    size_t count = 0;
+
+    for(void* block = sfpool_mt_it_first(&pool,&it);block != NULL;
+        block = sfpool_mt_it_next(&it))
+    {
+        count++;
+    }
+
+    assert(count == 16);
+    assert(pool.skipped_pages == skipped);
+
+    for(size_t i = 0;i < 16;i++)
+    {
+        sfpool_mt_free(&pool,kept[i]);
+    }
+
+    sfpool_mt_destroy(&pool);
+}
+
+int main (void)
+{
+    test_limit();
+    test_stress();
+    test_deferred();
+    test_iterator();
+    test_concurrent_iterator();
+    test_busy_page();
+
+    printf("test_mt: ok\n");
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "sfpool.h"
+#include <assert.h>
+
+static void test_layout (void)
+{
+	typedef SFPool<24, 16> FPool;
+	typedef SFPool<40, 8, 32> FAlignedPool;
+
+	FPool Pool;
+	FAlignedPool Aligned;
+
+	/* the compile time layout is the one of the C pool */
+	static_assert(sizeof(FPool) == sizeof(struct sfpool), "not a plain sfpool");
+	assert(FPool::Distance == Pool.GetPool()->block_distance);
+	assert(FAlignedPool::Distance == Aligned.GetPool()->block_distance);
+
+	for(int i = 0; i < 100; i++)
+	{
+		void* Block = Aligned.Alloc();
+		struct sfpool_page* Page = (struct sfpool_page*) *(((size_t*) Block) - 1);
+
+		assert((size_t) Block % 32 == 0);
+		assert(FAlignedPool::BlockAt(Page, i % 8) == Block);
+	}
+}
+
+static void test_mixed (void)
+{
+	SFPool<16, 4> Pool;
+	void* Blocks[64];
+
+	/* blocks go back and forth between the template and the C functions */
+	for(int i = 0; i < 64; i++)
+	{
+		Blocks[i] = i % 2 ? Pool.Alloc() : sfpool_alloc(Pool.GetPool());
+		*(int*) Blocks[i] = i;
+	}
+
+	assert(Pool.GetPool()->page_count == 16);
+
+	struct sfpool_it It;
+	int Count = 0;
+
+	for(int* Block = (int*) sfpool_it_first(Pool.GetPool(), &It); Block; Block = (int*) sfpool_it_next(&It))
+	{
+		assert(*Block == Count);
+		Count++;
+	}
+
+	assert(Count == 64);
+
+	for(int i = 0; i < 64; i++)
+	{
+		if(i % 3)
+		{
+			Pool.Free(Blocks[i]);
+		}
+		else
+		{
+			sfpool_free(Pool.GetPool(), Blocks[i]);
+		}
+	}
+
+	/* the slow path of Free() deletes pages which get entirely free */
+	assert(Pool.GetPool()->page_count == 0);
+}
+
+static void test_reuse (void)
+{
+	SFPool<16, 4> Pool;
+	void* Blocks[16];
+
+	for(int i = 0; i < 16; i++)
+	{
+		Blocks[i] = Pool.Alloc();
+	}
+
+	/* every block of a full page which is freed is reused before a new page is added */
+	for(int i = 0; i < 16; i += 2)
+	{
+		Pool.Free(Blocks[i]);
+	}
+
+	for(int i = 0; i < 16; i += 2)
+	{
+		Blocks[i] = Pool.Alloc();
+	}
+
+	assert(Pool.GetPool()->page_count == 4);
+
+	for(int i = 0; i < 16; i++)
+	{
+		Pool.Free(Blocks[i]);
+	}
+}
+
+int main (void)
+{
+	test_layout();
+	test_mixed();
+	test_reuse();
+
+	printf("test_pool: ok\n");
+	return 0;
+}
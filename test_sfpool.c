@@ -0,0 +1,766 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sfpool.h"
+#include <assert.h>
+#include <time.h>
+
+static void test_owner (void)
+{
+    struct sfpool a,b;
+    void* blocks[100];
+    size_t word = 0;
+    bool_t freed;
+
+    sfpool_create(&a,24,8,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_create(&b,100,3,SFPOOL_EXPAND_TYPE_ONE);
+
+    for(size_t i = 0;i < 100;i++)
+    {
+        blocks[i] = sfpool_alloc(i % 2 ? &a : &b);
+        assert(sfpool_owner(blocks[i]) == (i % 2 ? &a : &b));
+    }
+
+    /* pointers which are not blocks of a pool are rejected */
+    void* heap = malloc(64);
+
+    assert(sfpool_owner(NULL) == NULL);
+    assert(sfpool_owner(&word) == NULL);
+    assert(sfpool_owner(heap) == NULL);
+    assert(sfpool_owner((char*) blocks[1] + 8) == NULL);
+    freed = sfpool_free_any(heap);
+    assert(freed == 0);
+
+    free(heap);
+
+    /* a freed block is not owned anymore */
+    freed = sfpool_free_any(blocks[0]);
+    assert(freed == 1);
+    assert(sfpool_owner(blocks[0]) == NULL);
+    freed = sfpool_free_any(blocks[0]);
+    assert(freed == 0);
+
+    for(size_t i = 1;i < 100;i++)
+    {
+        freed = sfpool_free_any(blocks[i]);
+        assert(freed == 1);
+    }
+
+    /* all pages are gone, and so are their map entries */
+    assert(a.page_count == 0 && b.page_count == 0);
+    assert(sfpool_owner(blocks[1]) == NULL);
+
+    sfpool_destroy(&a);
+    sfpool_destroy(&b);
+}
+
+static void test_color (void)
+{
+    struct sfpool pool;
+    struct sfpool_it it;
+    void* blocks[40 * 20];
+
+    /* a page of 40 * 64 bytes leaves 1.5 KiB of a granule as slack */
+    sfpool_create(&pool,64 - sizeof(size_t),40,SFPOOL_EXPAND_TYPE_ONE);
+    assert(pool.color_count > 1);
+
+    for(size_t i = 0;i < 40 * 20;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+        *(size_t*) blocks[i] = i;
+    }
+
+    /* the first block of every page starts at a different cache line offset */
+    for(size_t i = 40;i < 40 * 20;i += 40)
+    {
+        size_t offset = (size_t) blocks[i] % SFPOOL_MAP_GRANULE;
+        size_t previous = (size_t) blocks[i - 40] % SFPOOL_MAP_GRANULE;
+
+        assert((offset - previous) % SFPOOL_MAP_GRANULE == SFPOOL_CACHE_LINE ||
+               offset < previous);
+        assert(sfpool_owner(blocks[i]) == &pool);
+    }
+
+    /* the iterator walks colored pages as well */
+    size_t count = 0;
+
+    for(size_t* block = sfpool_it_first(&pool,&it);block;block = sfpool_it_next(&it))
+    {
+        assert(*block == count);
+        count++;
+    }
+
+    assert(count == 40 * 20);
+    assert(sfpool_set_coloring(&pool,0) == -1);
+
+    sfpool_destroy(&pool);
+
+    /* a budget is charged the same for every page, whatever its color */
+    struct sfpool_budget budget;
+    int ret;
+
+    sfpool_create(&pool,64 - sizeof(size_t),40,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_budget_create(&budget,1 << 20,SFPOOL_BUDGET_FAIL,0,NULL,NULL);
+    assert(ret == 0);
+    sfpool_set_budget(&pool,&budget);
+
+    for(size_t i = 0;i < 40 * 5;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+        assert(blocks[i] != NULL);
+
+        if(i == 0)
+        {
+            count = budget.used;
+        }
+    }
+
+    assert(budget.used == 5 * count);
+
+    sfpool_destroy(&pool);
+    assert(budget.used == 0);
+    sfpool_budget_destroy(&budget);
+
+    /* without coloring every page starts on a granule boundary */
+    sfpool_create(&pool,64 - sizeof(size_t),40,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_set_coloring(&pool,0);
+    assert(ret == 0);
+    assert(pool.color_count == 1);
+
+    for(size_t i = 0;i < 40 * 5;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+    }
+
+    for(size_t i = 40;i < 40 * 5;i += 40)
+    {
+        assert((size_t) blocks[i] % SFPOOL_MAP_GRANULE == (size_t) blocks[0] % SFPOOL_MAP_GRANULE);
+    }
+
+    sfpool_destroy(&pool);
+}
+
+/* small pages share granule aligned slabs */
+static void test_slab (void)
+{
+    struct sfpool pool;
+    void* blocks[8 * 200];
+
+    sfpool_create(&pool,64 - sizeof(size_t),8,SFPOOL_EXPAND_TYPE_ONE);
+    assert(pool.slab_stride != 0);
+
+    for(size_t i = 0;i < 8 * 200;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+        assert(blocks[i] != NULL);
+    }
+
+    /* the pages of the first slab follow each other */
+    assert((size_t) ((char*) blocks[8] - (char*) blocks[0]) == pool.slab_stride);
+
+    for(size_t i = 0;i < 8 * 200;i++)
+    {
+        assert(sfpool_owner(blocks[i]) == &pool);
+        assert(sfpool_owner((char*) blocks[i] + 1) == NULL);
+    }
+
+    /* give every other page back, then take them again from the same slabs */
+    for(size_t i = 0;i < 8 * 200;i += 16)
+    {
+        for(size_t j = i;j < i + 8;j++)
+        {
+            sfpool_free(&pool,blocks[j]);
+        }
+    }
+
+    assert(pool.page_count == 100);
+
+    for(size_t i = 0;i < 8 * 200;i += 16)
+    {
+        assert(sfpool_owner(blocks[i]) == NULL);
+    }
+
+    for(size_t i = 0;i < 8 * 200;i += 16)
+    {
+        for(size_t j = i;j < i + 8;j++)
+        {
+            blocks[j] = sfpool_alloc(&pool);
+            assert(sfpool_owner(blocks[j]) == &pool);
+        }
+    }
+
+    assert(pool.page_count == 200);
+
+    for(size_t i = 0;i < 8 * 200;i++)
+    {
+        sfpool_free(&pool,blocks[i]);
+    }
+
+    assert(pool.page_count == 0);
+    assert(pool.slabs == NULL);
+
+    /* mapped pages are never carved */
+    assert(sfpool_set_page_mapped(&pool,1) == 0);
+    assert(pool.slab_stride == 0);
+
+    sfpool_destroy(&pool);
+}
+
+/* the page descriptor of an allocated block is in its header */
+static struct sfpool_page* page_of (void* block)
+{
+    return (struct sfpool_page*) *(((size_t*) block) - 1);
+}
+
+static void test_aligned (void)
+{
+    struct sfpool pool;
+    int ret;
+    void* block;
+
+    /* blocks of every color keep the alignment */
+    ret = sfpool_create_aligned(&pool,40,8,64,SFPOOL_EXPAND_TYPE_ONE);
+    assert(ret == 0);
+
+    for(size_t i = 0;i < 8 * 100;i++)
+    {
+        block = sfpool_alloc(&pool);
+        assert((size_t) block % 64 == 0);
+    }
+
+    sfpool_destroy(&pool);
+
+    /* alignments which are not a power of two or larger than a cache line */
+    ret = sfpool_create_aligned(&pool,40,8,48,SFPOOL_EXPAND_TYPE_ONE);
+    assert(ret == -1);
+    ret = sfpool_create_aligned(&pool,40,8,128,SFPOOL_EXPAND_TYPE_ONE);
+    assert(ret == -1);
+    ret = sfpool_create_aligned(&pool,40,8,1,SFPOOL_EXPAND_TYPE_ONE);
+    assert(ret == 0);
+    assert(pool.block_align == sizeof(size_t));
+}
+
+static void test_descriptors (void)
+{
+    struct sfpool pool;
+    void* blocks[4 * 200];
+
+    sfpool_create(&pool,16,4,SFPOOL_EXPAND_TYPE_ONE);
+
+    for(size_t i = 0;i < 4 * 200;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+    }
+
+    /* descriptors of pages which were added in a row are packed together */
+    size_t packed = 0;
+
+    for(size_t i = 4;i < 4 * 200;i += 4)
+    {
+        packed += page_of(blocks[i]) == page_of(blocks[i - 4]) + 1;
+        assert(page_of(blocks[i])->pool == &pool);
+    }
+
+    /* only the borders between descriptor tables break the run */
+    assert(packed >= 200 - 1 - pool.table_count);
+
+    if(sizeof(size_t) == 8)
+    {
+        assert(sizeof(struct sfpool_page) == SFPOOL_CACHE_LINE);
+    }
+
+    /* the descriptor of a deleted page is the next one to be used */
+    struct sfpool_page* page = page_of(blocks[40]);
+
+    for(size_t i = 40;i < 44;i++)
+    {
+        sfpool_free(&pool,blocks[i]);
+    }
+
+    assert(pool.page_count == 199);
+
+    for(size_t i = 40;i < 44;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+    }
+
+    assert(page_of(blocks[40]) == page);
+
+    sfpool_destroy(&pool);
+}
+
+static double now_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void test_budget_fail (void)
+{
+    struct sfpool_budget budget;
+    struct sfpool pool;
+    void* blocks[16];
+    int ret;
+    void* block;
+
+    /* a page of 4 blocks of 64 bytes takes 256 bytes, and the budget is 2 pages */
+    sfpool_create(&pool,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_budget_create(&budget,512,SFPOOL_BUDGET_FAIL,0,NULL,NULL);
+    assert(ret == 0);
+    sfpool_set_budget(&pool,&budget);
+
+    for(size_t i = 0;i < 8;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+        assert(blocks[i] != NULL);
+    }
+
+    assert(budget.used == 512);
+    block = sfpool_alloc(&pool);
+    assert(block == NULL);
+
+    /* a block freed in a full page is reused without a new page */
+    sfpool_free(&pool,blocks[4]);
+    blocks[4] = sfpool_alloc(&pool);
+    assert(blocks[4] != NULL);
+    assert(budget.used == 512);
+    block = sfpool_alloc(&pool);
+    assert(block == NULL);
+
+    /* a deleted page goes back to the budget */
+    for(size_t i = 0;i < 4;i++)
+    {
+        sfpool_free(&pool,blocks[i]);
+    }
+
+    assert(budget.used == 256);
+    block = sfpool_alloc(&pool);
+    assert(block != NULL);
+
+    sfpool_destroy(&pool);
+    assert(budget.used == 0);
+    sfpool_budget_destroy(&budget);
+}
+
+/* shared by the pools of test_budget_wait() */
+static struct sfpool_budget shared;
+static struct sfpool other;
+static void* other_blocks[4];
+
+static void* release_later (void* arg)
+{
+    struct timespec delay = { 0,100 * 1000000 };
+
+    nanosleep(&delay,NULL);
+
+    /* giving the whole page back wakes up the waiting thread */
+    for(size_t i = 0;i < 4;i++)
+    {
+        sfpool_free(&other,other_blocks[i]);
+    }
+
+    return NULL;
+}
+
+static void test_budget_wait (void)
+{
+    struct sfpool pool;
+    pthread_t thread;
+    int ret;
+    void* block;
+
+    sfpool_create(&pool,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_create(&other,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+
+    ret = sfpool_budget_create(&shared,512,SFPOOL_BUDGET_WAIT,50,NULL,NULL);
+    assert(ret == 0);
+    sfpool_set_budget(&pool,&shared);
+    sfpool_set_budget(&other,&shared);
+
+    for(size_t i = 0;i < 4;i++)
+    {
+        block = sfpool_alloc(&pool);
+        assert(block != NULL);
+        other_blocks[i] = sfpool_alloc(&other);
+        assert(other_blocks[i] != NULL);
+    }
+
+    /* nobody gives anything back, the wait times out */
+    double start = now_ms();
+
+    block = sfpool_alloc(&pool);
+    assert(block == NULL);
+    assert(now_ms() - start >= 45);
+
+    /* another thread gives a page back while we wait */
+    shared.timeout_ms = 5000;
+    start = now_ms();
+
+    pthread_create(&thread,NULL,release_later,NULL);
+    block = sfpool_alloc(&pool);
+    assert(block != NULL);
+    assert(now_ms() - start < 5000);
+    pthread_join(thread,NULL);
+
+    assert(other.page_count == 0);
+    assert(pool.page_count == 2);
+
+    sfpool_destroy(&pool);
+    sfpool_destroy(&other);
+    sfpool_budget_destroy(&shared);
+}
+
+static bool_t reclaim (struct sfpool* pool,size_t needed,void* ctx)
+{
+    struct sfpool_it it;
+    void* block = sfpool_it_first((struct sfpool*) ctx,&it);
+
+    if(block == NULL)
+    {
+        return 0;
+    }
+
+    /* free the whole first page of the cache pool */
+    for(size_t i = 0;i < 4 && block != NULL;i++)
+    {
+        void* next = sfpool_it_next(&it);
+        sfpool_free((struct sfpool*) ctx,block);
+        block = next;
+    }
+
+    return 1;
+}
+
+/* claims to free something, but never gives a page back */
+static bool_t reclaim_nothing (struct sfpool* pool,size_t needed,void* ctx)
+{
+    (*(size_t*) ctx)++;
+    return 1;
+}
+
+/* frees a block of the pool which asks for the page */
+static bool_t reclaim_block (struct sfpool* pool,size_t needed,void* ctx)
+{
+    void** block = (void**) ctx;
+
+    if(*block == NULL)
+    {
+        return 0;
+    }
+
+    sfpool_free(pool,*block);
+    *block = NULL;
+
+    return 1;
+}
+
+static void test_budget_reclaim (void)
+{
+    struct sfpool_budget budget;
+    struct sfpool pool,cache;
+    int ret;
+    void* block;
+
+    sfpool_create(&pool,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+    sfpool_create(&cache,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+
+    ret = sfpool_budget_create(&budget,1024,SFPOOL_BUDGET_RECLAIM,0,reclaim,&cache);
+    assert(ret == 0);
+    sfpool_set_budget(&pool,&budget);
+    sfpool_set_budget(&cache,&budget);
+
+    /* the cache takes the whole budget */
+    for(size_t i = 0;i < 16;i++)
+    {
+        block = sfpool_alloc(&cache);
+        assert(block != NULL);
+    }
+
+    /* then the pool takes it back from the cache, page by page */
+    for(size_t i = 0;i < 16;i++)
+    {
+        block = sfpool_alloc(&pool);
+        assert(block != NULL);
+    }
+
+    assert(cache.page_count == 0);
+    assert(budget.used == 1024);
+
+    /* nothing is left to reclaim */
+    block = sfpool_alloc(&pool);
+    assert(block == NULL);
+
+    sfpool_destroy(&pool);
+    sfpool_destroy(&cache);
+    sfpool_budget_destroy(&budget);
+
+    /* a callback which does not lower the budget is not called again */
+    size_t calls = 0;
+
+    sfpool_create(&pool,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_budget_create(&budget,256,SFPOOL_BUDGET_RECLAIM,0,reclaim_nothing,&calls);
+    assert(ret == 0);
+    sfpool_set_budget(&pool,&budget);
+
+    for(size_t i = 0;i < 4;i++)
+    {
+        block = sfpool_alloc(&pool);
+        assert(block != NULL);
+    }
+
+    block = sfpool_alloc(&pool);
+    assert(block == NULL);
+    assert(calls == 1);
+
+    sfpool_destroy(&pool);
+    sfpool_budget_destroy(&budget);
+
+    /* a callback which frees a block of the same pool makes room for it */
+    void* victim = NULL;
+
+    sfpool_create(&pool,64 - sizeof(size_t),4,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_budget_create(&budget,256,SFPOOL_BUDGET_RECLAIM,0,reclaim_block,&victim);
+    assert(ret == 0);
+    sfpool_set_budget(&pool,&budget);
+
+    for(size_t i = 0;i < 4;i++)
+    {
+        block = sfpool_alloc(&pool);
+        assert(block != NULL);
+        victim = block;
+    }
+
+    block = sfpool_alloc(&pool);
+    assert(block != NULL);
+    assert(victim == NULL);
+    assert(pool.page_count == 1);
+
+    sfpool_destroy(&pool);
+    sfpool_budget_destroy(&budget);
+}
+
+static bool_t is_odd (void* block,void* ctx)
+{
+    (*(size_t*) ctx)++;
+    return *(size_t*) block % 2;
+}
+
+static bool_t is_small (void* block,void* ctx)
+{
+    return *(size_t*) block < *(size_t*) ctx;
+}
+
+static void test_sweep (void)
+{
+    struct sfpool pool;
+    struct sfpool_it it;
+    size_t calls = 0;
+    size_t swept;
+    void* block;
+
+    sfpool_create(&pool,sizeof(size_t),8,SFPOOL_EXPAND_TYPE_ONE);
+
+    for(size_t i = 0;i < 8 * 10;i++)
+    {
+        *(size_t*) sfpool_alloc(&pool) = i;
+    }
+
+    /* the predicate sees every used block once */
+    swept = sfpool_sweep(&pool,is_odd,&calls);
+    assert(swept == 8 * 10 / 2);
+    assert(calls == 8 * 10);
+    assert(pool.page_count == 10);
+
+    size_t count = 0;
+
+    for(size_t* block = sfpool_it_first(&pool,&it);block;block = sfpool_it_next(&it))
+    {
+        assert(*block == count * 2);
+        count++;
+    }
+
+    assert(count == 8 * 10 / 2);
+
+    /* pages which get entirely free are deleted, the others are kept */
+    size_t limit = 40;
+
+    swept = sfpool_sweep(&pool,is_small,&limit);
+    assert(swept == 20);
+    assert(pool.page_count == 5);
+
+    /* blocks freed by a sweep are allocated again, without a new page */
+    for(size_t i = 0;i < 5 * 4;i++)
+    {
+        block = sfpool_alloc(&pool);
+        assert(block != NULL);
+    }
+
+    assert(pool.page_count == 5);
+
+    limit = (size_t) -1;
+    sfpool_sweep(&pool,is_small,&limit);
+    assert(pool.page_count == 0);
+    assert(pool.first_page == NULL && pool.free_pages == NULL);
+
+    sfpool_destroy(&pool);
+}
+
+static bool_t is_zero (void* block,size_t size)
+{
+    for(size_t i = 0;i < size;i++)
+    {
+        if(((unsigned char*) block)[i] != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void test_calloc (void)
+{
+    struct sfpool pool;
+    struct sfpool_it it;
+    void* blocks[8];
+    void* block;
+    int ret;
+    size_t swept;
+
+    /* pages come from the heap by default, every block has to be cleared */
+    sfpool_create(&pool,100,8,SFPOOL_EXPAND_TYPE_ONE);
+
+    for(size_t i = 0;i < 8;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+        memset(blocks[i],0xFF,pool.block_size);
+    }
+
+    for(size_t i = 0;i < 8;i += 2)
+    {
+        sfpool_free(&pool,blocks[i]);
+    }
+
+    for(size_t i = 0;i < 8;i++)
+    {
+        block = sfpool_calloc(&pool);
+        assert(is_zero(block,pool.block_size));
+    }
+
+    assert(pool.zero_saved == 0);
+    assert(pool.zero_cleared == 8 * pool.block_size);
+    sfpool_destroy(&pool);
+
+    /* fresh blocks of a mapped page are known to be zero */
+    sfpool_create(&pool,1000,64,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_set_page_mapped(&pool,1);
+    assert(ret == 0);
+
+    for(size_t i = 0;i < 3;i++)
+    {
+        blocks[i] = sfpool_calloc(&pool);
+        assert(is_zero(blocks[i],pool.block_size));
+        memset(blocks[i],0xFF,pool.block_size);
+    }
+
+    assert(pool.zero_saved == 3 * pool.block_size);
+    assert(pool.zero_cleared == 0);
+
+    /* only the blocks which were handed out are walked, forward and backward */
+    size_t count = 0;
+
+    for(void* block = sfpool_it_first(&pool,&it);block;block = sfpool_it_next(&it))
+    {
+        assert(block == blocks[count]);
+        count++;
+    }
+
+    assert(count == 3);
+    block = sfpool_it_last(&pool,&it);
+    assert(block == blocks[2]);
+    assert(sfpool_owner(blocks[2]) == &pool);
+    assert(sfpool_owner((char*) blocks[2] + (sizeof(size_t) + pool.block_size)) == NULL);
+
+    /* a recycled block is cleared */
+    sfpool_free(&pool,blocks[1]);
+    block = sfpool_calloc(&pool);
+    assert(block == blocks[1]);
+    assert(is_zero(blocks[1],pool.block_size));
+    assert(pool.zero_saved == 3 * pool.block_size);
+    assert(pool.zero_cleared == pool.block_size);
+
+    sfpool_destroy(&pool);
+
+    /* a pool which zeroes on free never clears a block in sfpool_calloc() */
+    sfpool_create(&pool,100,8,SFPOOL_EXPAND_TYPE_ONE);
+    ret = sfpool_set_zero_on_free(&pool,1);
+    assert(ret == 0);
+
+    for(size_t i = 0;i < 8;i++)
+    {
+        blocks[i] = sfpool_alloc(&pool);
+        memset(blocks[i],0xFF,pool.block_size);
+        *(size_t*) blocks[i] = i;
+    }
+
+    sfpool_free(&pool,blocks[0]);
+    assert(is_zero(blocks[0],pool.block_size));
+
+    assert(pool.zero_cleared == pool.block_size);
+
+    /* a sweep zeroes the blocks it frees as well */
+    size_t limit = 3;
+
+    swept = sfpool_sweep(&pool,is_small,&limit);
+    assert(swept == 2);
+    assert(is_zero(blocks[1],pool.block_size) && is_zero(blocks[2],pool.block_size));
+
+    assert(pool.zero_cleared == 3 * pool.block_size);
+
+    /* the blocks were counted as cleared when they were freed, not again */
+    for(size_t i = 0;i < 3;i++)
+    {
+        block = sfpool_calloc(&pool);
+        assert(is_zero(block,pool.block_size));
+    }
+
+    assert(pool.zero_cleared == 3 * pool.block_size);
+    assert(pool.zero_saved == 0);
+
+    sfpool_destroy(&pool);
+
+    /* the modes can not change while the pool has free blocks which are not zero */
+    sfpool_create(&pool,100,8,SFPOOL_EXPAND_TYPE_ONE);
+
+    blocks[0] = sfpool_alloc(&pool);
+    memset(blocks[0],0xFF,pool.block_size);
+    blocks[1] = sfpool_alloc(&pool);
+    sfpool_free(&pool,blocks[0]);
+
+    ret = sfpool_set_zero_on_free(&pool,1);
+    assert(ret == -1);
+    ret = sfpool_set_page_mapped(&pool,1);
+    assert(ret == -1);
+    block = sfpool_calloc(&pool);
+    assert(is_zero(block,pool.block_size));
+
+    sfpool_destroy(&pool);
+}
+
+int main (void)
+{
+    test_owner();
+    test_color();
+    test_slab();
+    test_aligned();
+    test_descriptors();
+    test_budget_fail();
+    test_budget_wait();
+    test_budget_reclaim();
+    test_sweep();
+    test_calloc();
+
+    printf("test_sfpool: ok\n");
+    return 0;
+}